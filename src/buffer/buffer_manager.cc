@@ -1,47 +1,131 @@
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <system_error>
 
 #include "buffer/buffer_manager.h"
+#include "buffer/numa.h"
 #include "common/macros.h"
 #include "storage/file.h"
 #include "storage/slotted_page.h"
 
 /*
-This is a dummy implementation of a buffer manager. It does not do any locking.
+Locking protocol:
+ - The page table is split into shards with their own mutex. A frame is
+   fixed (fix_count > 0) while the shard of its page is locked, so a lookup
+   and an eviction of the same page never interleave.
+ - The frames are split into partitions. A page is loaded into frames of
+   the partition it hashes to, its home. Only when all of them are fixed, it
+   borrows a frame of another partition.
+ - Page loads, evictions and discards are serialized by the load_mutex of the
+   home partition of the page. Taking or evicting a frame also needs the
+   load_mutex of the partition of the frame. A thread only blocks on the
+   load_mutex of a partition with a higher index than the ones it holds, and
+   otherwise tries to lock it, so there are no cycles. The read of a new page
+   happens after the load_mutexes are released, while the loading thread
+   holds the frame latch exclusively.
+ - The replacer of a partition is protected by its replacer_mutex, which is
+   never held while acquiring a shard mutex from a lookup.
  */
 
 namespace buzzdb {
 
+namespace {
+
+/// Adds the time until it is destroyed to the fix latency histogram, for
+/// every `period`-th fix of a thread. A period of 0 times no fix.
+class FixTimer {
+public:
+	FixTimer(BufferStats& stats, uint32_t period) : stats_(stats) {
+		thread_local uint32_t fixes = 0;
+		if (period > 0 && ++fixes >= period) {
+			fixes = 0;
+			timed_ = true;
+			start_ = std::chrono::steady_clock::now();
+		}
+	}
+
+	~FixTimer() {
+		if (timed_) {
+			stats_.add_fix_latency(std::chrono::steady_clock::now() - start_);
+		}
+	}
+
+private:
+	BufferStats& stats_;
+	bool timed_ = false;
+	std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace
+
 char* BufferFrame::get_data() {
-	return data.data();
+	return data;
 }
 
 
-BufferManager::BufferManager(size_t page_size, size_t page_count) {
+BufferManager::BufferManager(size_t page_size, size_t page_count,
+		ReplacementPolicy policy, size_t partition_count)
+	: page_table_(page_count) {
 	capacity_ = page_count;
-	page_counter_ = 0;
 	page_size_ = page_size;
+	policy_ = policy;
+	// Frames are aligned, so whole pages can bypass the OS page cache
+	io_mode_ = page_size_ % File::DIRECT_IO_ALIGNMENT == 0 ?
+			File::IOMode::DIRECT : File::IOMode::BUFFERED;
 
-	pool_.resize(capacity_);
-	for (size_t frame_id = 0; frame_id < capacity_; frame_id++) {
-		pool_[frame_id].reset(new BufferFrame());
-		pool_[frame_id]->data.resize(page_size_);
-		pool_[frame_id]->page_id = INVALID_PAGE_ID;
-		pool_[frame_id]->frame_id = frame_id;
+	// Bind the memory of each partition to its own node, if there are
+	// several nodes
+	size_t node_count = numa::get_node_count();
+	if (partition_count == 0) {
+		partition_count = node_count;
 	}
+	partition_count = std::max<size_t>(1, std::min(partition_count, capacity_));
 
+	// The frames of a partition are carved from one arena, their
+	// descriptors are kept in a separate dense array
+	pool_.reset(new BufferFrame[capacity_]);
+	for (size_t index = 0; index < partition_count; index++) {
+		auto partition = std::make_unique<Partition>();
+		partition->first_frame_id = capacity_ * index / partition_count;
+		partition->frame_count =
+				capacity_ * (index + 1) / partition_count - partition->first_frame_id;
+		partition->numa_node = node_count > 1 ?
+				static_cast<int>(index % node_count) : -1;
+		partition->arena.reset(new FrameArena(page_size_,
+				partition->frame_count, true, partition->numa_node));
+		partition->replacer =
+				Replacer::make_replacer(policy_, partition->frame_count);
+		for (size_t i = 0; i < partition->frame_count; i++) {
+			BufferFrame& frame = pool_[partition->first_frame_id + i];
+			frame.data = partition->arena->get_frame(i);
+			frame.page_id = INVALID_PAGE_ID;
+			frame.frame_id = partition->first_frame_id + i;
+			frame.dirty = false;
+			frame.partition = static_cast<uint32_t>(index);
+		}
+		reset_free_frames(*partition);
+		partitions_.push_back(std::move(partition));
+	}
 }
 
 BufferManager::~BufferManager() {
+	stop_background_writer();
 	for (size_t frame_id = 0; frame_id < capacity_; frame_id++) {
-		if (pool_[frame_id]->dirty == true) {
+		if (pool_[frame_id].dirty == true) {
 			write_frame(frame_id);
 		}
 	}
+	for (auto& entry : segments_) {
+		entry.second->file->sync();
+	}
 }
 
-BufferFrame& BufferManager::fix_page(uint64_t page_id, bool /*exclusive*/) {
+BufferFrame& BufferManager::fix_page(uint64_t page_id, bool exclusive,
+		BufferRing* ring) {
 
 //	std::cout << "Fix page: " << page_id << "\n";
 
@@ -50,57 +134,664 @@ BufferFrame& BufferManager::fix_page(uint64_t page_id, bool /*exclusive*/) {
 		exit(-1);
 	}
 
+	FixTimer timer(stats_, fix_latency_period_.load(std::memory_order_relaxed));
+
+	if (mapped_segment_count_ > 0) {
+		Segment& segment = get_segment(get_segment_id(page_id));
+		if (segment.mapped) {
+			return fix_mapped_page(segment, page_id, exclusive);
+		}
+	}
+
 	/// Check if page is in buffer
-	uint64_t page_frame_id = get_frame_id_of_page(page_id);
+	bool claimed;
+	uint64_t page_frame_id = pin_or_claim_page(page_id, claimed, ring);
+	BufferFrame& frame = pool_[page_frame_id];
+
+	if (claimed) {
+		// When the misses of the segment are sequential, read the following
+		// pages together with this one
+		std::vector<uint64_t> loads = {page_frame_id};
+		uint16_t segment_id = get_segment_id(page_id);
+		uint64_t segment_page_id = get_segment_page_id(page_id);
+		Segment& segment = get_segment(segment_id);
+		stats_.add(BufferCounter::MISSES);
+		segment.stats.add(BufferCounter::MISSES);
+		auto& next_sequential_page = segment.next_sequential_page;
+		if (next_sequential_page.exchange(segment_page_id + 1) == segment_page_id) {
+			size_t window = get_read_ahead_window();
+			if (ring != nullptr) {
+				window = std::min(window, ring->size() / 2);
+			}
+			claim_read_ahead(segment_id, segment_page_id + 1, window, loads, ring);
+			next_sequential_page = segment_page_id + 1 + window;
+		}
+
+		try {
+			if (loads.size() == 1) {
+				read_frame(page_frame_id);
+			} else {
+				transfer_frames(loads, File::IORequest::READ);
+			}
+		} catch (...) {
+			for (uint64_t frame_id : loads) {
+				abort_load(pool_[frame_id]);
+			}
+			throw;
+		}
+
+		finish_load(frame, exclusive);
+		for (uint64_t frame_id : loads) {
+			if (frame_id != page_frame_id) {
+				finish_load(pool_[frame_id], true);
+				unfix_page(pool_[frame_id], false);
+			}
+		}
+		return frame;
+	}
+
+	stats_.add(BufferCounter::HITS);
+	if (ring == nullptr) {
+		record_access(frame);
+		// A page of a ring that is used while the scan does not hold it is
+		// part of the working set now
+		if (frame.ring.load(std::memory_order_relaxed) != nullptr &&
+				frame.fix_count == 1) {
+			frame.ring = nullptr;
+		}
+	}
+	lock_frame(frame, exclusive);
+	return frame;
+}
+
+std::vector<BufferFrame*> BufferManager::fix_pages(
+		const std::vector<uint64_t>& page_ids, bool exclusive) {
+
+	std::vector<BufferFrame*> frames;
+	std::vector<bool> claimed_frames;
+	std::vector<uint64_t> loads;
+
+	// Undoes the fixes done so far
+	auto release_frames = [&]() {
+		for (size_t i = 0; i < frames.size(); i++) {
+			if (claimed_frames[i]) {
+				abort_load(*frames[i]);
+			} else {
+				unfix_page(*frames[i], false);
+			}
+		}
+	};
+
+	try {
+		for (uint64_t page_id : page_ids) {
+			bool claimed;
+			uint64_t page_frame_id = pin_or_claim_page(page_id, claimed);
+			BufferFrame& frame = pool_[page_frame_id];
+			if (claimed) {
+				stats_.add(BufferCounter::MISSES);
+				get_segment(get_segment_id(page_id)).stats.add(BufferCounter::MISSES);
+				loads.push_back(page_frame_id);
+			} else {
+				stats_.add(BufferCounter::HITS);
+				record_access(frame);
+				lock_frame(frame, exclusive);
+			}
+			frames.push_back(&frame);
+			claimed_frames.push_back(claimed);
+		}
+
+		// Read all missing pages at once
+		transfer_frames(loads, File::IORequest::READ);
+	} catch (...) {
+		release_frames();
+		throw;
+	}
+
+	for (size_t i = 0; i < frames.size(); i++) {
+		if (claimed_frames[i]) {
+			finish_load(*frames[i], exclusive);
+		}
+	}
+	return frames;
+}
+
+BufferFrame& BufferManager::fix_mapped_page(Segment& segment,
+		uint64_t page_id, bool exclusive) {
+	if (exclusive) {
+		throw read_only_segment_error{};
+	}
+	uint64_t segment_page_id = get_segment_page_id(page_id);
+	if (segment_page_id >= segment.mapped_frames.size()) {
+		throw std::out_of_range("page is beyond the end of the mapped segment");
+	}
+	BufferFrame& frame = *segment.mapped_frames[segment_page_id];
+	frame.fix_count++;
+	stats_.add(BufferCounter::HITS);
+	return frame;
+}
+
+void BufferManager::map_segment(uint16_t segment_id,
+		File::AccessAdvice advice) {
+	Segment& segment = get_segment(segment_id);
+	if (segment.mapped) {
+		return;
+	}
+
+	// The pool must not hold newer versions of the pages than the file
+	std::vector<uint64_t> page_ids;
+	for (size_t frame_id = 0; frame_id < capacity_; frame_id++) {
+		uint64_t page_id = pool_[frame_id].page_id;
+		if (page_id != INVALID_PAGE_ID && get_segment_id(page_id) == segment_id) {
+			page_ids.push_back(page_id);
+		}
+	}
+	for (uint64_t page_id : page_ids) {
+		flush_page(page_id);
+		discard_page(page_id);
+	}
+
+	File& file_handle = *segment.file;
+	size_t segment_page_count = file_handle.size() / page_size_;
+	const char* mapping = nullptr;
+	if (segment_page_count > 0) {
+		mapping = file_handle.map_read_only();
+		if (mapping == nullptr) {
+			throw std::system_error{errno, std::system_category()};
+		}
+		file_handle.advise(0, file_handle.size(), advice);
+	}
+
+	segment.mapped_frames.resize(segment_page_count);
+	for (size_t segment_page_id = 0; segment_page_id < segment_page_count;
+			segment_page_id++) {
+		auto& frame = segment.mapped_frames[segment_page_id];
+		frame.reset(new BufferFrame());
+		frame->frame_id = INVALID_FRAME_ID;
+		frame->page_id = get_overall_page_id(segment_id, segment_page_id);
+		frame->data = const_cast<char*>(mapping + segment_page_id * page_size_);
+		frame->dirty = false;
+		frame->read_only = true;
+	}
+	segment.mapped = true;
+	mapped_segment_count_++;
+}
+
+void BufferManager::prefetch_pages(uint16_t segment_id,
+		uint64_t first_segment_page_id, size_t page_count, BufferRing* ring) {
+
+	if (mapped_segment_count_ > 0) {
+		Segment& segment = get_segment(segment_id);
+		if (segment.mapped) {
+			segment.file->advise(first_segment_page_id * page_size_,
+					page_count * page_size_, File::AccessAdvice::WILLNEED);
+			return;
+		}
+	}
+
+	// Like the read-ahead of fix_page(), do not claim more than a window of
+	// the pool at once
+	page_count = std::min(page_count, get_read_ahead_window());
+	if (ring != nullptr) {
+		page_count = std::min(page_count, ring->size() / 2);
+	}
+	std::vector<uint64_t> loads;
+	claim_read_ahead(segment_id, first_segment_page_id, page_count, loads, ring);
+
+	try {
+		transfer_frames(loads, File::IORequest::READ);
+	} catch (...) {
+		for (uint64_t frame_id : loads) {
+			abort_load(pool_[frame_id]);
+		}
+		throw;
+	}
+
+	for (uint64_t frame_id : loads) {
+		finish_load(pool_[frame_id], true);
+		unfix_page(pool_[frame_id], false);
+	}
+}
+
+void BufferManager::claim_read_ahead(uint16_t segment_id,
+		uint64_t first_segment_page_id, size_t page_count,
+		std::vector<uint64_t>& loads, BufferRing* ring) {
+
+	// Pages beyond the end of the file have never been written
+	Segment& segment = get_segment(segment_id);
+	BufferStats& segment_stats = segment.stats;
+	uint64_t segment_page_count = segment.file->size() / page_size_;
+	uint64_t end_segment_page_id = std::min<uint64_t>(
+			first_segment_page_id + page_count, segment_page_count);
+
+	for (uint64_t segment_page_id = first_segment_page_id;
+			segment_page_id < end_segment_page_id;
+			segment_page_id++) {
+		bool claimed;
+		uint64_t page_frame_id;
+		try {
+			page_frame_id = pin_or_claim_page(
+					get_overall_page_id(segment_id, segment_page_id), claimed, ring);
+		} catch (const buffer_full_error&) {
+			// Read-ahead must not fail the access that triggered it
+			break;
+		}
+		if (claimed) {
+			stats_.add(BufferCounter::PREFETCHED_PAGES);
+			segment_stats.add(BufferCounter::PREFETCHED_PAGES);
+			loads.push_back(page_frame_id);
+		} else {
+			pool_[page_frame_id].fix_count--;
+		}
+	}
+}
+
+size_t BufferManager::get_read_ahead_window() const {
+	return std::min(READ_AHEAD_PAGES, capacity_ / partitions_.size() / 4);
+}
+
+size_t BufferManager::get_partition_of_page(uint64_t page_id) const {
+	if (partitions_.size() <= 1) {
+		return 0;
+	}
+	// Fibonacci hashing of the extent, like in the page table
+	uint64_t extent = get_overall_page_id(get_segment_id(page_id),
+			get_segment_page_id(page_id) / PARTITION_EXTENT_PAGES);
+	uint64_t hash = extent * 0x9E3779B97F4A7C15ull;
+	return (hash >> 32) % partitions_.size();
+}
+
+size_t BufferManager::get_local_partition() const {
+	int node = numa::get_current_node();
+	for (size_t index = 0; index < partitions_.size(); index++) {
+		if (partitions_[index]->numa_node == node) {
+			return index;
+		}
+	}
+	return 0;
+}
+
+void BufferManager::record_access(const BufferFrame& frame) {
+	Partition& partition = get_frame_partition(frame);
+	std::lock_guard<std::mutex> guard(partition.replacer_mutex);
+	partition.replacer->record_access(frame.frame_id - partition.first_frame_id);
+}
+
+uint64_t BufferManager::pin_or_claim_page(uint64_t page_id, bool& claimed,
+		BufferRing* ring) {
+	claimed = false;
+	uint64_t page_frame_id = pin_resident_page(page_id);
+	if (page_frame_id != INVALID_FRAME_ID) {
+		return page_frame_id;
+	}
+
+	size_t home = get_partition_of_page(page_id);
+	Partition& partition = *partitions_[home];
+	std::lock_guard<std::mutex> load_guard(partition.load_mutex);
+
+	// Another thread may have loaded the page in the meantime
+	page_frame_id = pin_resident_page(page_id);
 	if (page_frame_id != INVALID_FRAME_ID) {
-		return *pool_[page_frame_id];
+		return page_frame_id;
 	}
 
 //	std::cout << "Create page: " << page_id << "\n";
 
-	// Create a new page
-	uint64_t free_frame_id = page_counter_++;
+	// Load the page into a free frame or evict one
+	std::unique_lock<std::mutex> remote_guard;
+	uint64_t free_frame_id;
+	try {
+		free_frame_id = ring != nullptr ?
+				get_ring_frame(partition, *ring) :
+				get_free_frame(partition, partition);
+	} catch (const buffer_full_error&) {
+		free_frame_id = get_remote_frame(home, remote_guard);
+	}
+	BufferFrame& frame = pool_[free_frame_id];
 
-	if(page_counter_ >= capacity_){
-		std::cout << "Out of space \n";
-		std::cout << page_counter_ << " " << capacity_ << "\n";
-		exit(-1);
+	frame.page_id = page_id;
+	frame.ring = ring;
+	frame.dirty = false;
+	frame.fix_count = 1;
+	// Nobody else can hold the latch of a frame that is not in the page table
+	UNUSED_ATTRIBUTE bool locked = frame.latch.try_lock();
+	assert(locked);
+	frame.exclusive_owner = std::this_thread::get_id();
+	frame.exclusive_depth = 1;
+	page_table_.insert(page_id, free_frame_id);
+
+	claimed = true;
+	return free_frame_id;
+}
+
+void BufferManager::finish_load(BufferFrame& frame, bool exclusive) {
+	{
+		Partition& partition = get_frame_partition(frame);
+		std::lock_guard<std::mutex> guard(partition.replacer_mutex);
+		partition.replacer->record_insert(
+				frame.frame_id - partition.first_frame_id);
+	}
+
+	if (!exclusive) {
+		// The latch is not downgraded atomically, so another thread may fix
+		// the page exclusively in between, and we wait for it. That is fine:
+		// the page is loaded and our fix keeps it from being evicted.
+		unlock_frame(frame);
+		frame.latch.lock_shared();
 	}
+}
 
-	pool_[free_frame_id]->page_id = page_id;
-	pool_[free_frame_id]->dirty = false;
+void BufferManager::abort_load(BufferFrame& frame) {
+	page_table_.erase(frame.page_id);
+	unlock_frame(frame);
 
-	read_frame(free_frame_id);
+	Partition& partition = get_frame_partition(frame);
+	std::lock_guard<std::mutex> load_guard(partition.load_mutex);
+	reset_frame(frame.frame_id);
+	partition.free_frames.push_back(frame.frame_id);
+}
+
+uint64_t BufferManager::pin_resident_page(uint64_t page_id) {
+	return page_table_.find(page_id, [this](uint64_t frame_id) {
+		pool_[frame_id].fix_count++;
+	});
+}
 
-	return *pool_[free_frame_id];
+void BufferManager::lock_frame(BufferFrame& frame, bool exclusive) {
+	auto this_thread = std::this_thread::get_id();
+	if (frame.exclusive_owner.load() == this_thread) {
+		// Nested fix by the thread that holds the page exclusively
+		frame.exclusive_depth++;
+		return;
+	}
+	bool locked = exclusive ? frame.latch.try_lock() :
+			frame.latch.try_lock_shared();
+	if (!locked) {
+		auto start = std::chrono::steady_clock::now();
+		if (exclusive) {
+			frame.latch.lock();
+		} else {
+			frame.latch.lock_shared();
+		}
+		stats_.add(BufferCounter::LATCH_WAITS);
+		stats_.add(BufferCounter::LATCH_WAIT_NANOSECONDS,
+				std::chrono::duration_cast<std::chrono::nanoseconds>(
+						std::chrono::steady_clock::now() - start).count());
+	}
+	if (exclusive) {
+		frame.exclusive_owner = this_thread;
+		frame.exclusive_depth = 1;
+	}
+}
+
+void BufferManager::unlock_frame(BufferFrame& frame) {
+	if (frame.exclusive_owner.load() == std::this_thread::get_id()) {
+		if (--frame.exclusive_depth == 0) {
+			frame.exclusive_owner = std::thread::id();
+			frame.latch.unlock();
+		}
+		return;
+	}
+	frame.latch.unlock_shared();
+}
+
+uint64_t BufferManager::get_free_frame(Partition& partition,
+		Partition& home) {
+	if (!partition.free_frames.empty()) {
+		uint64_t frame_id = partition.free_frames.back();
+		partition.free_frames.pop_back();
+		return frame_id;
+	}
+
+	// A victim that borrowed the frame from another partition is written
+	// back under the load_mutex of its home as well, so that a reload of
+	// the page cannot read the old version
+	std::unique_lock<std::mutex> victim_guard;
+	auto try_evict = [this, &partition, &home, &victim_guard](
+			uint64_t partition_frame_id) {
+		BufferFrame& frame = pool_[partition.first_frame_id + partition_frame_id];
+		if (frame.fix_count != 0) {
+			return false;
+		}
+		Partition& victim_home = *partitions_[get_partition_of_page(frame.page_id)];
+		std::unique_lock<std::mutex> guard;
+		if (&victim_home != &partition && &victim_home != &home) {
+			guard = std::unique_lock<std::mutex>(victim_home.load_mutex,
+					std::try_to_lock);
+			if (!guard.owns_lock()) {
+				return false;
+			}
+		}
+		if (!try_unmap_frame(frame)) {
+			return false;
+		}
+		victim_guard = std::move(guard);
+		return true;
+	};
+
+	uint64_t victim_frame_id;
+	{
+		std::lock_guard<std::mutex> guard(partition.replacer_mutex);
+		victim_frame_id = partition.replacer->pick_victim(try_evict);
+	}
+	if (victim_frame_id == INVALID_FRAME_ID) {
+		throw buffer_full_error{};
+	}
+	victim_frame_id += partition.first_frame_id;
+	evict_frame(victim_frame_id);
+	return victim_frame_id;
+}
+
+uint64_t BufferManager::get_remote_frame(size_t home,
+		std::unique_lock<std::mutex>& remote_guard) {
+	for (size_t i = 1; i < partitions_.size(); i++) {
+		size_t index = (home + i) % partitions_.size();
+		Partition& remote = *partitions_[index];
+		std::unique_lock<std::mutex> guard(remote.load_mutex, std::defer_lock);
+		if (index > home) {
+			guard.lock();
+		} else if (!guard.try_lock()) {
+			continue;
+		}
+		try {
+			uint64_t frame_id = get_free_frame(remote, *partitions_[home]);
+			stats_.add(BufferCounter::REMOTE_FRAMES);
+			remote_guard = std::move(guard);
+			return frame_id;
+		} catch (const buffer_full_error&) {
+			// All frames of this partition are fixed as well
+		}
+	}
+	throw buffer_full_error{};
+}
+
+uint64_t BufferManager::get_ring_frame(Partition& partition,
+		BufferRing& ring) {
+	uint64_t& slot = ring.frames[ring.position];
+	ring.position = (ring.position + 1) % ring.frames.size();
+
+	if (slot != INVALID_FRAME_ID) {
+		BufferFrame& frame = pool_[slot];
+		// A page that borrowed the frame would need its home locked as well
+		if (&get_frame_partition(frame) == &partition && frame.ring == &ring &&
+				partitions_[get_partition_of_page(frame.page_id)].get() ==
+						&partition &&
+				try_unmap_frame(frame)) {
+			{
+				std::lock_guard<std::mutex> guard(partition.replacer_mutex);
+				partition.replacer->remove(slot - partition.first_frame_id);
+			}
+			stats_.add(BufferCounter::RING_REUSES);
+			evict_frame(slot);
+			return slot;
+		}
+	}
+
+	// The frame in the slot is fixed or used by others, leave it to the
+	// replacement policy
+	slot = get_free_frame(partition, partition);
+	return slot;
+}
+
+bool BufferManager::try_unmap_frame(BufferFrame& frame) {
+	return frame.fix_count == 0 &&
+			page_table_.erase_if(frame.page_id, [&frame](uint64_t) {
+				return frame.fix_count == 0;
+			});
+}
+
+void BufferManager::evict_frame(uint64_t frame_id) {
+	// The frame is no longer reachable through the page table. Write it
+	// back before releasing the load_mutex, so that a reload of the page
+	// sees the latest version.
+	stats_.add(BufferCounter::EVICTIONS);
+	if (pool_[frame_id].dirty) {
+		stats_.add(BufferCounter::DIRTY_EVICTIONS);
+		write_frame(frame_id);
+		foreground_writes_++;
+		// The background writer is falling behind
+		writer_wakeup_.notify_one();
+	}
+	reset_frame(frame_id);
+}
+
+BufferManager::Segment& BufferManager::get_segment(uint16_t segment_id) {
+	{
+		std::shared_lock<std::shared_mutex> guard(segments_mutex_);
+		auto entry = segments_.find(segment_id);
+		if (entry != segments_.end()) {
+			return *entry->second;
+		}
+	}
+
+	std::unique_lock<std::shared_mutex> guard(segments_mutex_);
+	auto& segment = segments_[segment_id];
+	if (!segment) {
+		auto file_handle = File::open_async_file(
+				std::to_string(segment_id).c_str(), File::WRITE, io_mode_);
+		segment.reset(new Segment());
+		segment->file = std::move(file_handle);
+	}
+	return *segment;
 }
 
 void BufferManager::read_frame(uint64_t frame_id) {
 
-	auto segment_id = get_segment_id(pool_[frame_id]->page_id);
-	auto file_handle =
-			File::open_file(std::to_string(segment_id).c_str(), File::WRITE);
-	size_t start = get_segment_page_id(pool_[frame_id]->page_id) * page_size_;
+	auto segment_id = get_segment_id(pool_[frame_id].page_id);
+	File& file_handle = get_segment_file(segment_id);
+	size_t start = get_segment_page_id(pool_[frame_id].page_id) * page_size_;
 	
-	file_handle->read_block(start, page_size_, pool_[frame_id]->data.data());
+	count_io(segment_id, File::IORequest::READ, 1);
+	file_handle.read_block(start, page_size_, pool_[frame_id].data);
 }
 
 void BufferManager::write_frame(uint64_t frame_id) {
 
-	auto segment_id = get_segment_id(pool_[frame_id]->page_id);
-	auto file_handle =
-			File::open_file(std::to_string(segment_id).c_str(), File::WRITE);
-	size_t start = get_segment_page_id(pool_[frame_id]->page_id) * page_size_;
+	auto segment_id = get_segment_id(pool_[frame_id].page_id);
+	File& file_handle = get_segment_file(segment_id);
+	size_t start = get_segment_page_id(pool_[frame_id].page_id) * page_size_;
+
+	count_io(segment_id, File::IORequest::WRITE, 1);
+	file_handle.write_block(pool_[frame_id].data, start, page_size_);
+}
 
-	file_handle->write_block(pool_[frame_id]->data.data(), start, page_size_);
+void BufferManager::count_io(uint16_t segment_id, File::IORequest::Type type,
+		size_t page_count) {
+	bool read = type == File::IORequest::READ;
+	auto pages = read ? BufferCounter::READ_PAGES : BufferCounter::WRITTEN_PAGES;
+	auto bytes = read ? BufferCounter::READ_BYTES : BufferCounter::WRITTEN_BYTES;
+	BufferStats& segment_stats = get_segment(segment_id).stats;
+	stats_.add(pages, page_count);
+	stats_.add(bytes, page_count * page_size_);
+	segment_stats.add(pages, page_count);
+	segment_stats.add(bytes, page_count * page_size_);
+}
+
+void BufferManager::transfer_frames(std::vector<uint64_t>& frame_ids,
+		File::IORequest::Type type) {
+
+	// Order the frames by page, so that the requests of a segment are
+	// adjacent and sequential
+	std::sort(frame_ids.begin(), frame_ids.end(),
+			[this](uint64_t lhs, uint64_t rhs) {
+				return pool_[lhs].page_id < pool_[rhs].page_id;
+			});
+
+	std::vector<File::IORequest> requests(frame_ids.size());
+	for (size_t i = 0; i < frame_ids.size(); i++) {
+		BufferFrame& frame = pool_[frame_ids[i]];
+		size_t start = get_segment_page_id(frame.page_id) * page_size_;
+		requests[i] = File::IORequest(type, start, page_size_, frame.data);
+	}
+
+	// Submit the requests of all segments before waiting for any of them
+	std::vector<std::pair<File*, size_t>> runs;
+	std::exception_ptr error;
+	size_t submitted = 0;
+	try {
+		for (size_t begin = 0; begin < frame_ids.size();) {
+			uint16_t segment_id = get_segment_id(pool_[frame_ids[begin]].page_id);
+			size_t end = begin;
+			while (end < frame_ids.size() &&
+					get_segment_id(pool_[frame_ids[end]].page_id) == segment_id) {
+				end++;
+			}
+			File& file_handle = get_segment_file(segment_id);
+			count_io(segment_id, type, end - begin);
+			file_handle.submit(&requests[begin], end - begin);
+			runs.emplace_back(&file_handle, begin);
+			submitted = end;
+			begin = end;
+		}
+	} catch (...) {
+		// The runs submitted so far still transfer into the frames, so wait
+		// for them before the error is reported
+		error = std::current_exception();
+	}
+
+	for (size_t run = 0; run < runs.size(); run++) {
+		size_t begin = runs[run].second;
+		size_t end = (run + 1 < runs.size()) ? runs[run + 1].second : submitted;
+		try {
+			runs[run].first->complete(&requests[begin], end - begin);
+		} catch (...) {
+			// Keep waiting for the other runs, their frames are still in use
+			error = std::current_exception();
+		}
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
 }
 
 void BufferManager::unfix_page(BufferFrame& page, bool is_dirty) {
 
-	if (!page.dirty) {
-		page.dirty = is_dirty;
+	if (page.read_only) {
+		page.fix_count--;
+		if (is_dirty) {
+			throw read_only_segment_error{};
+		}
+		return;
+	}
+
+	if (is_dirty && !page.dirty.exchange(true)) {
+		page.dirty_since =
+				std::chrono::steady_clock::now().time_since_epoch().count();
 	}
 
+	unlock_frame(page);
+	page.fix_count--;
+
+}
+
+bool BufferManager::flush_frame(BufferFrame& frame) {
+	lock_frame(frame, false);
+	bool written = frame.dirty;
+	if (written) {
+		write_frame(frame.frame_id);
+		frame.dirty = false;
+	}
+	unlock_frame(frame);
+	return written;
 }
 
 void  BufferManager::flush_page(uint64_t page_id){
@@ -108,75 +799,478 @@ void  BufferManager::flush_page(uint64_t page_id){
 	// std::cout << "FLUSH: " << page_id << "\n";
 
 	/// Check if page is in buffer
-	uint64_t page_frame_id = get_frame_id_of_page(page_id);
+	uint64_t page_frame_id = pin_resident_page(page_id);
 	if (page_frame_id != INVALID_FRAME_ID) {
-		if (pool_[page_frame_id]->dirty == true) {
-			write_frame(page_frame_id);
+		BufferFrame& frame = pool_[page_frame_id];
+		bool written;
+		try {
+			written = flush_frame(frame);
+		} catch (...) {
+			frame.fix_count--;
+			throw;
+		}
+		frame.fix_count--;
+		if (written) {
+			get_segment_file(get_segment_id(page_id)).sync();
 		}
 	}
 
+	rethrow_writer_error();
 }
 
 void  BufferManager::discard_page(uint64_t page_id){
 
+	// The background writer must not write the page while it is dropped
+	std::lock_guard<std::mutex> writer_guard(writer_mutex_);
+	Partition& partition = *partitions_[get_partition_of_page(page_id)];
+	std::unique_lock<std::mutex> load_guard(partition.load_mutex);
+	std::unique_lock<std::mutex> frame_guard;
+
 	/// Check if page is in buffer
-	uint64_t page_frame_id = get_frame_id_of_page(page_id);
-	if (page_frame_id != INVALID_FRAME_ID) {
-		pool_[page_frame_id].reset(new BufferFrame());
-		pool_[page_frame_id]->page_id = INVALID_PAGE_ID;
-		pool_[page_frame_id]->dirty = false;
-		pool_[page_frame_id]->data.resize(page_size_);
+	uint64_t page_frame_id;
+	while (true) {
+		page_frame_id = get_frame_id_of_page(page_id);
+		if (page_frame_id == INVALID_FRAME_ID) {
+			return;
+		}
+		// The page may have borrowed a frame of another partition, whose free
+		// list we need as well
+		Partition& frame_partition = get_frame_partition(pool_[page_frame_id]);
+		if (&frame_partition == &partition ||
+				frame_guard.mutex() == &frame_partition.load_mutex) {
+			break;
+		}
+		frame_guard = std::unique_lock<std::mutex>(frame_partition.load_mutex,
+				std::defer_lock);
+		if (!frame_guard.try_lock()) {
+			// Wait for both without holding one of them, then look again
+			load_guard.unlock();
+			std::lock(load_guard, frame_guard);
+		}
+	}
+
+	Partition& frame_partition = get_frame_partition(pool_[page_frame_id]);
+	page_table_.erase(page_id);
+	{
+		std::lock_guard<std::mutex> guard(frame_partition.replacer_mutex);
+		frame_partition.replacer->remove(
+				page_frame_id - frame_partition.first_frame_id);
 	}
+	reset_frame(page_frame_id);
+	frame_partition.free_frames.push_back(page_frame_id);
+
+}
+
+void BufferManager::write_pages(uint16_t segment_id,
+		uint64_t first_segment_page_id, char* pages, size_t page_count) {
+	Segment& segment = get_segment(segment_id);
+	if (segment.mapped) {
+		throw read_only_segment_error{};
+	}
+	assert(reinterpret_cast<uintptr_t>(pages) % FrameArena::ALIGNMENT == 0);
+
+	// Stale copies must neither be read nor written back later
+	for (size_t i = 0; i < page_count; i++) {
+		discard_page(get_overall_page_id(segment_id, first_segment_page_id + i));
+	}
+
+	File::IORequest request(File::IORequest::WRITE,
+			first_segment_page_id * page_size_, page_count * page_size_, pages);
+	count_io(segment_id, File::IORequest::WRITE, page_count);
+	segment.file->submit(&request, 1);
+	segment.file->complete(&request, 1);
+}
 
+void BufferManager::sync_segment(uint16_t segment_id) {
+	get_segment_file(segment_id).sync();
 }
 
 void  BufferManager::flush_all_pages(){
 
 //	std::cout << "FLUSH ALL PAGES \n";
 
+	// Dirty frames that are fixed and latched, waiting to be written
+	std::vector<uint64_t> batch;
+	// Segments that were written to and have to be synced once at the end
+	std::vector<uint16_t> written_segments;
+
+	auto flush_batch = [this, &batch, &written_segments]() {
+		for (uint64_t frame_id : batch) {
+			uint16_t segment_id = get_segment_id(pool_[frame_id].page_id);
+			if (std::find(written_segments.begin(), written_segments.end(),
+					segment_id) == written_segments.end()) {
+				written_segments.push_back(segment_id);
+			}
+		}
+		std::exception_ptr error;
+		try {
+			write_frames(batch);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		for (uint64_t frame_id : batch) {
+			if (!error) {
+				pool_[frame_id].dirty = false;
+			}
+			unlock_frame(pool_[frame_id]);
+			pool_[frame_id].fix_count--;
+		}
+		batch.clear();
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	};
+
 	for (size_t frame_id = 0; frame_id < capacity_; frame_id++) {
-		if (pool_[frame_id]->dirty == true) {
-			write_frame(frame_id);
+		if (!pool_[frame_id].dirty) {
+			continue;
+		}
+		// Fix the frame through the page table, so that it is not evicted
+		// while being written
+		uint64_t page_id = pool_[frame_id].page_id;
+		if (page_id == INVALID_PAGE_ID) {
+			continue;
+		}
+		uint64_t page_frame_id = pin_resident_page(page_id);
+		if (page_frame_id == INVALID_FRAME_ID) {
+			continue;
+		}
+		BufferFrame& frame = pool_[page_frame_id];
+		lock_frame(frame, false);
+		if (!frame.dirty) {
+			unlock_frame(frame);
+			frame.fix_count--;
+			continue;
+		}
+
+		batch.push_back(page_frame_id);
+		if (batch.size() == MAX_IO_BATCH) {
+			flush_batch();
 		}
 	}
+	flush_batch();
 
+	for (uint16_t segment_id : written_segments) {
+		get_segment_file(segment_id).sync();
+	}
+
+	rethrow_writer_error();
 }
 
 void  BufferManager::discard_all_pages(){
 
 //	std::cout << "DISCARD ALL PAGES \n";
 
+	std::lock_guard<std::mutex> writer_guard(writer_mutex_);
+	page_table_.clear();
 	for (size_t frame_id = 0; frame_id < capacity_; frame_id++) {
-		pool_[frame_id].reset(new BufferFrame());
-		pool_[frame_id]->page_id = INVALID_PAGE_ID;
-		pool_[frame_id]->dirty = false;
-		pool_[frame_id]->data.resize(page_size_);
+		pool_[frame_id].page_id = INVALID_PAGE_ID;
+		pool_[frame_id].ring = nullptr;
+		pool_[frame_id].dirty = false;
+		pool_[frame_id].fix_count = 0;
+	}
+	for (auto& partition : partitions_) {
+		partition->arena->clear();
+		partition->replacer =
+				Replacer::make_replacer(policy_, partition->frame_count);
+		reset_free_frames(*partition);
 	}
 
 }
 
-uint64_t BufferManager::get_frame_id_of_page(uint64_t page_id){
+size_t BufferManager::write_frames(std::vector<uint64_t>& frame_ids) {
+	if (frame_ids.empty()) {
+		return 0;
+	}
+	std::sort(frame_ids.begin(), frame_ids.end(),
+			[this](uint64_t lhs, uint64_t rhs) {
+				return pool_[lhs].page_id < pool_[rhs].page_id;
+			});
 
-	uint64_t page_frame_id = INVALID_FRAME_ID;
+	// Copy runs of adjacent pages next to each other, so that each run is
+	// written with one request. The staging area is aligned for direct I/O.
+	FrameArena staging(page_size_ * frame_ids.size(), 1, false);
+	std::vector<File::IORequest> requests;
+	std::vector<File*> files;
+	for (size_t begin = 0; begin < frame_ids.size();) {
+		uint64_t first_page_id = pool_[frame_ids[begin]].page_id;
+		size_t end = begin + 1;
+		while (end < frame_ids.size() &&
+				pool_[frame_ids[end]].page_id == first_page_id + (end - begin) &&
+				get_segment_id(pool_[frame_ids[end]].page_id) ==
+						get_segment_id(first_page_id)) {
+			end++;
+		}
+		char* block = staging.get_frame(0) + begin * page_size_;
+		for (size_t i = begin; i < end; i++) {
+			std::memcpy(block + (i - begin) * page_size_, pool_[frame_ids[i]].data,
+					page_size_);
+		}
+		requests.emplace_back(File::IORequest::WRITE,
+				get_segment_page_id(first_page_id) * page_size_,
+				(end - begin) * page_size_, block);
+		files.push_back(&get_segment_file(get_segment_id(first_page_id)));
+		count_io(get_segment_id(first_page_id), File::IORequest::WRITE,
+				end - begin);
+		begin = end;
+	}
 
+	// Submit the requests of all segments before waiting for any of them
+	std::vector<std::pair<File*, size_t>> runs;
+	std::exception_ptr error;
+	size_t submitted = 0;
+	try {
+		for (size_t begin = 0; begin < requests.size();) {
+			size_t end = begin;
+			while (end < requests.size() && files[end] == files[begin]) {
+				end++;
+			}
+			files[begin]->submit(&requests[begin], end - begin);
+			runs.emplace_back(files[begin], begin);
+			submitted = end;
+			begin = end;
+		}
+	} catch (...) {
+		// The runs submitted so far still read from the staging area, which
+		// must outlive them
+		error = std::current_exception();
+	}
+
+	for (size_t run = 0; run < runs.size(); run++) {
+		size_t begin = runs[run].second;
+		size_t end = (run + 1 < runs.size()) ? runs[run + 1].second : submitted;
+		try {
+			runs[run].first->complete(&requests[begin], end - begin);
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	return requests.size();
+}
+
+void BufferManager::start_background_writer(
+		const BackgroundWriterOptions& options) {
+	std::lock_guard<std::mutex> guard(writer_mutex_);
+	if (writer_thread_.joinable()) {
+		return;
+	}
+	writer_options_ = options;
+	stop_writer_ = false;
+	writer_thread_ = std::thread([this]() {
+		std::unique_lock<std::mutex> guard(writer_mutex_);
+		while (!stop_writer_) {
+			writer_wakeup_.wait_for(guard, writer_options_.interval);
+			if (stop_writer_) {
+				break;
+			}
+			try {
+				run_writer_round();
+			} catch (...) {
+				// The pages stay dirty and are written by a later round or
+				// a flush. The next flush reports the error to its caller.
+				writer_write_errors_++;
+				std::lock_guard<std::mutex> error_guard(writer_error_mutex_);
+				if (!writer_error_) {
+					writer_error_ = std::current_exception();
+				}
+			}
+		}
+	});
+}
+
+void BufferManager::stop_background_writer() {
+	{
+		std::lock_guard<std::mutex> guard(writer_mutex_);
+		if (!writer_thread_.joinable()) {
+			return;
+		}
+		stop_writer_ = true;
+	}
+	writer_wakeup_.notify_one();
+	writer_thread_.join();
+}
+
+BufferStatsSnapshot BufferManager::get_stats() const {
+	return stats_.snapshot();
+}
+
+BufferStatsSnapshot BufferManager::get_segment_stats(uint16_t segment_id) {
+	std::shared_lock<std::shared_mutex> guard(segments_mutex_);
+	auto entry = segments_.find(segment_id);
+	if (entry == segments_.end()) {
+		return BufferStatsSnapshot();
+	}
+	return entry->second->stats.snapshot();
+}
+
+void BufferManager::set_fix_latency_period(uint32_t period) {
+	fix_latency_period_.store(period, std::memory_order_relaxed);
+}
+
+void BufferManager::reset_stats() {
+	stats_.reset();
+	std::shared_lock<std::shared_mutex> guard(segments_mutex_);
+	for (auto& entry : segments_) {
+		entry.second->stats.reset();
+	}
+}
+
+BackgroundWriterStats BufferManager::get_background_writer_stats() const {
+	BackgroundWriterStats stats;
+	stats.rounds = writer_rounds_;
+	stats.written_pages = writer_written_pages_;
+	stats.write_requests = writer_write_requests_;
+	stats.write_time = std::chrono::nanoseconds(writer_write_time_);
+	stats.foreground_writes = foreground_writes_;
+	stats.write_errors = writer_write_errors_;
+	return stats;
+}
+
+void BufferManager::rethrow_writer_error() {
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> guard(writer_error_mutex_);
+		std::swap(error, writer_error_);
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+void BufferManager::run_writer_round() {
+	writer_rounds_++;
+	const auto& options = writer_options_;
+	int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+	int64_t max_age = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			options.max_dirty_age).count();
+
+	// Select the dirty frames, oldest first
+	std::vector<std::pair<int64_t, uint64_t>> dirty_frames;
 	for (size_t frame_id = 0; frame_id < capacity_; frame_id++) {
-		if (pool_[frame_id]->page_id == page_id) {
-			page_frame_id = frame_id;
-			break;
+		if (pool_[frame_id].dirty) {
+			dirty_frames.emplace_back(pool_[frame_id].dirty_since, frame_id);
+		}
+	}
+	std::sort(dirty_frames.begin(), dirty_frames.end());
+
+	size_t excess = 0;
+	double dirty_ratio = capacity_ > 0 ?
+			static_cast<double>(dirty_frames.size()) / capacity_ : 0;
+	if (dirty_ratio > options.max_dirty_ratio) {
+		excess = dirty_frames.size() -
+				static_cast<size_t>(options.max_dirty_ratio / 2 * capacity_);
+	}
+	size_t count = 0;
+	while (count < dirty_frames.size() && count < options.max_pages_per_round &&
+			(count < excess || now - dirty_frames[count].first >= max_age)) {
+		count++;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	size_t written_pages = 0;
+	size_t write_requests = 0;
+	std::vector<uint64_t> batch;
+	auto write_batch = [this, &batch, &written_pages, &write_requests]() {
+		std::exception_ptr error;
+		try {
+			write_requests += write_frames(batch);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		for (uint64_t frame_id : batch) {
+			if (!error) {
+				pool_[frame_id].dirty = false;
+			}
+			pool_[frame_id].latch.unlock_shared();
+			pool_[frame_id].fix_count--;
+		}
+		if (!error) {
+			written_pages += batch.size();
+		}
+		batch.clear();
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	};
+
+	for (size_t i = 0; i < count; i++) {
+		uint64_t page_id = pool_[dirty_frames[i].second].page_id;
+		if (page_id == INVALID_PAGE_ID) {
+			continue;
 		}
+		uint64_t frame_id = pin_resident_page(page_id);
+		if (frame_id == INVALID_FRAME_ID) {
+			continue;
+		}
+		// Skip pages that are being modified instead of waiting for them
+		BufferFrame& frame = pool_[frame_id];
+		if (!frame.latch.try_lock_shared()) {
+			frame.fix_count--;
+			continue;
+		}
+		if (!frame.dirty) {
+			frame.latch.unlock_shared();
+			frame.fix_count--;
+			continue;
+		}
+		batch.push_back(frame_id);
+		if (batch.size() == MAX_IO_BATCH) {
+			write_batch();
+		}
+	}
+	write_batch();
+
+	writer_written_pages_ += written_pages;
+	writer_write_requests_ += write_requests;
+	writer_write_time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+void BufferManager::reset_free_frames(Partition& partition) {
+	// Hand out the frames in ascending order
+	partition.free_frames.clear();
+	for (size_t i = partition.frame_count; i > 0; i--) {
+		partition.free_frames.push_back(partition.first_frame_id + i - 1);
 	}
+}
+
+void BufferManager::reset_frame(uint64_t frame_id) {
+	pool_[frame_id].page_id = INVALID_PAGE_ID;
+	pool_[frame_id].ring = nullptr;
+	pool_[frame_id].dirty = false;
+	pool_[frame_id].fix_count = 0;
+	std::memset(pool_[frame_id].data, 0, page_size_);
+}
 
-	return page_frame_id;
+uint64_t BufferManager::get_frame_id_of_page(uint64_t page_id){
+	return page_table_.find(page_id);
 }
 
 
 std::vector<uint64_t> BufferManager::get_fifo_list() const {
-	return {};
+	std::vector<uint64_t> page_ids;
+	for (auto& partition : partitions_) {
+		std::lock_guard<std::mutex> guard(partition->replacer_mutex);
+		for (uint64_t frame_id : partition->replacer->get_fifo_list()) {
+			page_ids.push_back(pool_[partition->first_frame_id + frame_id].page_id);
+		}
+	}
+	return page_ids;
 }
 
 
 std::vector<uint64_t> BufferManager::get_lru_list() const {
-	return {};
+	std::vector<uint64_t> page_ids;
+	for (auto& partition : partitions_) {
+		std::lock_guard<std::mutex> guard(partition->replacer_mutex);
+		for (uint64_t frame_id : partition->replacer->get_lru_list()) {
+			page_ids.push_back(pool_[partition->first_frame_id + frame_id].page_id);
+		}
+	}
+	return page_ids;
 }
 
 }  // namespace buzzdb
@@ -0,0 +1,83 @@
+#include "buffer/buffer_stats.h"
+
+namespace buzzdb {
+
+namespace {
+
+/// Assigns the threads to shards round-robin
+std::atomic<size_t> next_thread_index{0};
+
+size_t get_thread_index() {
+	thread_local size_t index = next_thread_index++;
+	return index;
+}
+
+}  // namespace
+
+double BufferStatsSnapshot::get_hit_ratio() const {
+	uint64_t hits = get(BufferCounter::HITS);
+	uint64_t fixes = hits + get(BufferCounter::MISSES);
+	return fixes > 0 ? static_cast<double>(hits) / fixes : 0;
+}
+
+std::chrono::nanoseconds BufferStatsSnapshot::get_fix_latency_percentile(
+		double percentile) const {
+	uint64_t total = 0;
+	for (uint64_t count : fix_latency) {
+		total += count;
+	}
+	if (total == 0) {
+		return std::chrono::nanoseconds(0);
+	}
+	uint64_t rank = static_cast<uint64_t>(percentile / 100 * total);
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+		seen += fix_latency[bucket];
+		if (seen > rank || seen == total) {
+			return std::chrono::nanoseconds(1ull << bucket);
+		}
+	}
+	return std::chrono::nanoseconds(1ull << (LATENCY_BUCKETS - 1));
+}
+
+BufferStats::Shard& BufferStats::get_shard() {
+	return shards_[get_thread_index() % SHARD_COUNT];
+}
+
+void BufferStats::add_fix_latency(std::chrono::nanoseconds latency) {
+	uint64_t nanoseconds = latency.count() > 0 ? latency.count() : 0;
+	size_t bucket = 0;
+	while (bucket + 1 < BufferStatsSnapshot::LATENCY_BUCKETS &&
+			(1ull << bucket) <= nanoseconds) {
+		bucket++;
+	}
+	get_shard().fix_latency[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+BufferStatsSnapshot BufferStats::snapshot() const {
+	BufferStatsSnapshot snapshot;
+	for (const Shard& shard : shards_) {
+		for (size_t i = 0; i < snapshot.counters.size(); i++) {
+			snapshot.counters[i] +=
+					shard.counters[i].load(std::memory_order_relaxed);
+		}
+		for (size_t i = 0; i < snapshot.fix_latency.size(); i++) {
+			snapshot.fix_latency[i] +=
+					shard.fix_latency[i].load(std::memory_order_relaxed);
+		}
+	}
+	return snapshot;
+}
+
+void BufferStats::reset() {
+	for (Shard& shard : shards_) {
+		for (auto& counter : shard.counters) {
+			counter.store(0, std::memory_order_relaxed);
+		}
+		for (auto& counter : shard.fix_latency) {
+			counter.store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+}  // namespace buzzdb
@@ -0,0 +1,76 @@
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include "buffer/frame_arena.h"
+#include "buffer/numa.h"
+
+namespace buzzdb {
+
+namespace {
+
+size_t round_up(size_t value, size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+FrameArena::FrameArena(size_t frame_size, size_t frame_count,
+		bool huge_pages, int numa_node) {
+	stride_ = round_up(frame_size, ALIGNMENT);
+	size_ = round_up(stride_ * frame_count, ALIGNMENT);
+	if (size_ == 0) {
+		return;
+	}
+
+	void* memory = MAP_FAILED;
+	// Reserved huge pages are only used when they fill up the arena well
+	if (huge_pages && size_ >= HUGE_PAGE_SIZE) {
+		size_t huge_size = round_up(size_, HUGE_PAGE_SIZE);
+		memory = mmap(nullptr, huge_size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory != MAP_FAILED) {
+			size_ = huge_size;
+			huge_pages_ = true;
+		}
+	}
+	if (memory == MAP_FAILED) {
+		memory = mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED) {
+			throw std::system_error{errno, std::system_category()};
+		}
+#ifdef MADV_HUGEPAGE
+		// Otherwise let the kernel back the arena with transparent huge pages
+		if (huge_pages && size_ >= HUGE_PAGE_SIZE) {
+			madvise(memory, size_, MADV_HUGEPAGE);
+		}
+#endif
+	}
+	base_ = static_cast<char*>(memory);
+
+	// The memory has not been touched yet, so all of it follows the policy
+	if (numa_node >= 0) {
+		numa::prefer_node(base_, size_, numa_node);
+	}
+}
+
+FrameArena::~FrameArena() {
+	if (base_ != nullptr) {
+		munmap(base_, size_);
+	}
+}
+
+void FrameArena::clear() {
+	if (base_ == nullptr) {
+		return;
+	}
+	// Private anonymous pages read as zero after MADV_DONTNEED
+	if (madvise(base_, size_, MADV_DONTNEED) != 0) {
+		std::memset(base_, 0, size_);
+	}
+}
+
+}  // namespace buzzdb
@@ -0,0 +1,68 @@
+#include "buffer/numa.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+namespace buzzdb {
+namespace numa {
+
+namespace {
+
+/// Memory policy of mbind(2) that prefers one node
+constexpr int MPOL_PREFERRED_NODE = 1;
+
+}  // namespace
+
+size_t get_node_count() {
+	static const size_t node_count = [] {
+		// Contains a range list like "0" or "0-1"
+		std::ifstream online("/sys/devices/system/node/online");
+		std::string nodes;
+		if (!std::getline(online, nodes) || nodes.empty()) {
+			return size_t{1};
+		}
+		size_t last_node = 0;
+		size_t separator = nodes.find_last_of("-,");
+		try {
+			last_node = std::stoul(separator == std::string::npos ?
+					nodes : nodes.substr(separator + 1));
+		} catch (const std::exception&) {
+			return size_t{1};
+		}
+		return last_node + 1;
+	}();
+	return node_count;
+}
+
+int get_current_node() {
+#ifdef SYS_getcpu
+	unsigned cpu = 0;
+	unsigned node = 0;
+	if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+		return static_cast<int>(node);
+	}
+#endif
+	return 0;
+}
+
+bool prefer_node(void* memory, size_t size, int node) {
+#ifdef SYS_mbind
+	if (node < 0 || static_cast<size_t>(node) >= 8 * sizeof(unsigned long)) {
+		return false;
+	}
+	unsigned long node_mask = 1ul << node;
+	return ::syscall(SYS_mbind, memory, size, MPOL_PREFERRED_NODE, &node_mask,
+			8 * sizeof(node_mask), 0) == 0;
+#else
+	(void)memory;
+	(void)size;
+	(void)node;
+	return false;
+#endif
+}
+
+}  // namespace numa
+}  // namespace buzzdb
@@ -0,0 +1,51 @@
+#include "buffer/page_table.h"
+
+namespace buzzdb {
+
+PageTable::PageTable(size_t capacity, size_t shard_count) {
+	if (shard_count == 0) {
+		shard_count = 1;
+	}
+	shards_.resize(shard_count);
+	for (auto& shard : shards_) {
+		shard.reset(new Shard());
+		shard->frames.reserve(capacity / shard_count + 1);
+	}
+}
+
+PageTable::Shard& PageTable::get_shard(uint64_t page_id) const {
+	// Fibonacci hashing, so that consecutive pages of a segment are spread
+	// over all shards
+	uint64_t hash = page_id * 0x9E3779B97F4A7C15ull;
+	return *shards_[(hash >> 32) % shards_.size()];
+}
+
+uint64_t PageTable::find(uint64_t page_id) const {
+	Shard& shard = get_shard(page_id);
+	std::lock_guard<std::mutex> guard(shard.mutex);
+	auto entry = shard.frames.find(page_id);
+	if (entry == shard.frames.end()) {
+		return INVALID_FRAME_ID;
+	}
+	return entry->second;
+}
+
+void PageTable::insert(uint64_t page_id, uint64_t frame_id) {
+	Shard& shard = get_shard(page_id);
+	std::lock_guard<std::mutex> guard(shard.mutex);
+	shard.frames[page_id] = frame_id;
+}
+
+void PageTable::erase(uint64_t page_id) {
+	Shard& shard = get_shard(page_id);
+	std::lock_guard<std::mutex> guard(shard.mutex);
+	shard.frames.erase(page_id);
+}
+
+void PageTable::clear() {
+	for (auto& shard : shards_) {
+		shard->frames.clear();
+	}
+}
+
+}  // namespace buzzdb
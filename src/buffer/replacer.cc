@@ -0,0 +1,230 @@
+#include "buffer/replacer.h"
+
+#include <string>
+
+#include "common/macros.h"
+
+namespace buzzdb {
+
+std::unique_ptr<Replacer> Replacer::make_replacer(ReplacementPolicy policy,
+		size_t capacity) {
+	switch (policy) {
+		case ReplacementPolicy::LRU_K:
+			return std::make_unique<LRUKReplacer>(capacity);
+		case ReplacementPolicy::CLOCK:
+			return std::make_unique<ClockReplacer>(capacity);
+		case ReplacementPolicy::TWO_Q:
+		default:
+			return std::make_unique<TwoQReplacer>(capacity);
+	}
+}
+
+// 2Q
+
+TwoQReplacer::TwoQReplacer(size_t capacity) : entries_(capacity) {}
+
+void TwoQReplacer::record_insert(uint64_t frame_id) {
+	remove(frame_id);
+	entries_[frame_id].queue = Queue::FIFO;
+	entries_[frame_id].position = fifo_.insert(fifo_.end(), frame_id);
+}
+
+void TwoQReplacer::record_access(uint64_t frame_id) {
+	Entry& entry = entries_[frame_id];
+	switch (entry.queue) {
+		case Queue::NONE:
+			record_insert(frame_id);
+			return;
+		case Queue::FIFO:
+			// Second access, promote to the LRU queue
+			lru_.splice(lru_.end(), fifo_, entry.position);
+			entry.queue = Queue::LRU;
+			return;
+		case Queue::LRU:
+			lru_.splice(lru_.end(), lru_, entry.position);
+			return;
+	}
+}
+
+void TwoQReplacer::remove(uint64_t frame_id) {
+	Entry& entry = entries_[frame_id];
+	if (entry.queue == Queue::FIFO) {
+		fifo_.erase(entry.position);
+	} else if (entry.queue == Queue::LRU) {
+		lru_.erase(entry.position);
+	}
+	entry.queue = Queue::NONE;
+}
+
+uint64_t TwoQReplacer::pick_victim(
+		const std::function<bool(uint64_t)>& is_evictable) {
+	for (auto* queue : {&fifo_, &lru_}) {
+		for (uint64_t frame_id : *queue) {
+			if (is_evictable(frame_id)) {
+				remove(frame_id);
+				return frame_id;
+			}
+		}
+	}
+	return INVALID_FRAME_ID;
+}
+
+std::vector<uint64_t> TwoQReplacer::get_fifo_list() const {
+	return std::vector<uint64_t>(fifo_.begin(), fifo_.end());
+}
+
+std::vector<uint64_t> TwoQReplacer::get_lru_list() const {
+	return std::vector<uint64_t>(lru_.begin(), lru_.end());
+}
+
+// LRU-K
+
+LRUKReplacer::LRUKReplacer(size_t capacity, size_t k)
+	: k_(k == 0 ? 1 : k), entries_(capacity) {}
+
+LRUKReplacer::Key LRUKReplacer::get_key(uint64_t frame_id) const {
+	const Entry& entry = entries_[frame_id];
+	return Key(entry.history.size() >= k_, entry.history.front(), frame_id);
+}
+
+void LRUKReplacer::record_insert(uint64_t frame_id) {
+	remove(frame_id);
+	entries_[frame_id].tracked = true;
+	entries_[frame_id].history.push_back(current_timestamp_++);
+	eviction_order_.insert(get_key(frame_id));
+}
+
+void LRUKReplacer::record_access(uint64_t frame_id) {
+	Entry& entry = entries_[frame_id];
+	if (!entry.tracked) {
+		record_insert(frame_id);
+		return;
+	}
+	eviction_order_.erase(get_key(frame_id));
+	if (entry.history.size() == k_) {
+		entry.history.erase(entry.history.begin());
+	}
+	entry.history.push_back(current_timestamp_++);
+	eviction_order_.insert(get_key(frame_id));
+}
+
+void LRUKReplacer::remove(uint64_t frame_id) {
+	Entry& entry = entries_[frame_id];
+	if (!entry.tracked) {
+		return;
+	}
+	eviction_order_.erase(get_key(frame_id));
+	entry.tracked = false;
+	entry.history.clear();
+}
+
+uint64_t LRUKReplacer::pick_victim(
+		const std::function<bool(uint64_t)>& is_evictable) {
+	for (const Key& key : eviction_order_) {
+		uint64_t frame_id = std::get<2>(key);
+		if (is_evictable(frame_id)) {
+			remove(frame_id);
+			return frame_id;
+		}
+	}
+	return INVALID_FRAME_ID;
+}
+
+std::vector<uint64_t> LRUKReplacer::get_fifo_list() const {
+	std::vector<uint64_t> frames;
+	for (const Key& key : eviction_order_) {
+		if (!std::get<0>(key)) {
+			frames.push_back(std::get<2>(key));
+		}
+	}
+	return frames;
+}
+
+std::vector<uint64_t> LRUKReplacer::get_lru_list() const {
+	std::vector<uint64_t> frames;
+	for (const Key& key : eviction_order_) {
+		if (std::get<0>(key)) {
+			frames.push_back(std::get<2>(key));
+		}
+	}
+	return frames;
+}
+
+// CLOCK
+
+ClockReplacer::ClockReplacer(size_t capacity) : entries_(capacity) {}
+
+void ClockReplacer::record_insert(uint64_t frame_id) {
+	Entry& entry = entries_[frame_id];
+	if (!entry.tracked) {
+		tracked_count_++;
+	}
+	entry.tracked = true;
+	entry.usage_count = 1;
+}
+
+void ClockReplacer::record_access(uint64_t frame_id) {
+	Entry& entry = entries_[frame_id];
+	if (!entry.tracked) {
+		record_insert(frame_id);
+		return;
+	}
+	if (entry.usage_count < MAX_USAGE_COUNT) {
+		entry.usage_count++;
+	}
+}
+
+void ClockReplacer::remove(uint64_t frame_id) {
+	Entry& entry = entries_[frame_id];
+	if (entry.tracked) {
+		tracked_count_--;
+	}
+	entry.tracked = false;
+	entry.usage_count = 0;
+}
+
+uint64_t ClockReplacer::pick_victim(
+		const std::function<bool(uint64_t)>& is_evictable) {
+	if (tracked_count_ == 0) {
+		return INVALID_FRAME_ID;
+	}
+	// After MAX_USAGE_COUNT + 1 full rotations every unfixed frame has reached
+	// a usage count of zero, so give up afterwards
+	size_t max_steps = (MAX_USAGE_COUNT + 1) * entries_.size() + 1;
+	for (size_t step = 0; step < max_steps; step++) {
+		uint64_t frame_id = hand_;
+		hand_ = (hand_ + 1) % entries_.size();
+
+		Entry& entry = entries_[frame_id];
+		if (!entry.tracked) {
+			continue;
+		}
+		if (entry.usage_count > 0) {
+			entry.usage_count--;
+			continue;
+		}
+		if (!is_evictable(frame_id)) {
+			continue;
+		}
+		remove(frame_id);
+		return frame_id;
+	}
+	return INVALID_FRAME_ID;
+}
+
+std::vector<uint64_t> ClockReplacer::get_fifo_list() const {
+	std::vector<uint64_t> frames;
+	for (size_t step = 0; step < entries_.size(); step++) {
+		uint64_t frame_id = (hand_ + step) % entries_.size();
+		if (entries_[frame_id].tracked) {
+			frames.push_back(frame_id);
+		}
+	}
+	return frames;
+}
+
+std::vector<uint64_t> ClockReplacer::get_lru_list() const {
+	return {};
+}
+
+}  // namespace buzzdb
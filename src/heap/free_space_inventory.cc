@@ -0,0 +1,160 @@
+#include "heap/free_space_inventory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace buzzdb {
+
+FreeSpaceInventory::FreeSpaceInventory(uint16_t heap_segment_id,
+		uint32_t max_free_space, BufferManager& buffer_manager)
+	: heap_segment_id_(heap_segment_id),
+	  max_free_space_(max_free_space),
+	  buffer_manager_(buffer_manager) {
+	assert((heap_segment_id & SEGMENT_ID_BIT) == 0);
+}
+
+uint64_t FreeSpaceInventory::get_entries_per_page() const {
+	// Two entries per byte
+	return buffer_manager_.get_page_size() * 2;
+}
+
+uint64_t FreeSpaceInventory::get_fsi_page_id(uint64_t segment_page_id) const {
+	return BufferManager::get_overall_page_id(get_segment_id(heap_segment_id_),
+			segment_page_id / get_entries_per_page());
+}
+
+uint64_t FreeSpaceInventory::get_group(uint64_t segment_page_id) const {
+	uint64_t entries_per_page = get_entries_per_page();
+	uint64_t groups_per_page =
+			(entries_per_page + GROUP_PAGES - 1) / GROUP_PAGES;
+	return segment_page_id / entries_per_page * groups_per_page +
+			segment_page_id % entries_per_page / GROUP_PAGES;
+}
+
+uint64_t FreeSpaceInventory::get_group_begin(uint64_t segment_page_id) const {
+	uint64_t index = segment_page_id % get_entries_per_page();
+	return segment_page_id - index % GROUP_PAGES;
+}
+
+uint64_t FreeSpaceInventory::get_group_end(uint64_t segment_page_id) const {
+	uint64_t entries_per_page = get_entries_per_page();
+	uint64_t fsi_page_end =
+			(segment_page_id / entries_per_page + 1) * entries_per_page;
+	return std::min(get_group_begin(segment_page_id) + GROUP_PAGES,
+			fsi_page_end);
+}
+
+uint8_t FreeSpaceInventory::get_entry(const uint8_t* entries,
+		uint64_t segment_page_id) const {
+	uint64_t index = segment_page_id % get_entries_per_page();
+	return (entries[index / 2] >> (index % 2 * 4)) & 0x0f;
+}
+
+uint8_t FreeSpaceInventory::get_class(uint32_t free_space) const {
+	uint64_t free_class = static_cast<uint64_t>(free_space) * MAX_CLASS /
+			max_free_space_;
+	return std::min<uint64_t>(free_class, MAX_CLASS);
+}
+
+uint32_t FreeSpaceInventory::get_min_class(uint32_t size) const {
+	return (static_cast<uint64_t>(size) * MAX_CLASS + max_free_space_ - 1) /
+			max_free_space_;
+}
+
+void FreeSpaceInventory::add_page(uint64_t segment_page_id,
+		uint32_t free_space) {
+	if (segment_page_id % get_entries_per_page() == 0) {
+		// The FSI page is new. Clear what the frame held before, or the
+		// entries of a previous incarnation of the segment.
+		BufferFrame& frame =
+				buffer_manager_.fix_page(get_fsi_page_id(segment_page_id), true);
+		memset(frame.get_data(), 0, buffer_manager_.get_page_size());
+		buffer_manager_.unfix_page(frame, true);
+		group_classes_.resize(get_group(segment_page_id));
+	}
+	update(segment_page_id, free_space);
+}
+
+void FreeSpaceInventory::update(uint64_t segment_page_id, uint32_t free_space) {
+	uint64_t index = segment_page_id % get_entries_per_page();
+	BufferFrame& frame =
+			buffer_manager_.fix_page(get_fsi_page_id(segment_page_id), true);
+	auto* entries = reinterpret_cast<uint8_t*>(frame.get_data());
+	uint8_t free_class = get_class(free_space);
+	uint8_t old_class = get_entry(entries, segment_page_id);
+	uint8_t& entry = entries[index / 2];
+	if (index % 2 == 0) {
+		entry = (entry & 0xf0) | free_class;
+	} else {
+		entry = (entry & 0x0f) | (free_class << 4);
+	}
+
+	uint64_t group = get_group(segment_page_id);
+	if (group >= group_classes_.size()) {
+		group_classes_.resize(group + 1, 0);
+	}
+	uint8_t& group_class = group_classes_[group];
+	if (free_class >= group_class) {
+		group_class = free_class;
+	} else if (old_class == group_class) {
+		// The page may have been the one with the most free space
+		group_class = 0;
+		uint64_t end = get_group_end(segment_page_id);
+		for (uint64_t page = get_group_begin(segment_page_id); page < end;
+				page++) {
+			group_class = std::max(group_class, get_entry(entries, page));
+		}
+	}
+	buffer_manager_.unfix_page(frame, true);
+
+	if (free_class > 0) {
+		first_candidate_ = std::min(first_candidate_, segment_page_id);
+	}
+}
+
+bool FreeSpaceInventory::find(uint32_t size, uint64_t page_count,
+		uint64_t& segment_page_id) {
+	uint32_t min_class = get_min_class(size);
+	if (min_class > MAX_CLASS) {
+		return false;
+	}
+	uint64_t page = first_candidate_;
+	bool leading_full_pages = true;
+	while (page < page_count) {
+		uint64_t group = get_group(page);
+		uint64_t end = std::min(page_count, get_group_end(page));
+		uint8_t group_class = (group < group_classes_.size()) ?
+				group_classes_[group] : MAX_CLASS;
+		if (group_class < min_class) {
+			// No page of the group has enough room
+			if (leading_full_pages && group_class == 0) {
+				first_candidate_ = end;
+			} else {
+				leading_full_pages = false;
+			}
+			page = end;
+			continue;
+		}
+
+		BufferFrame& frame = buffer_manager_.fix_page(get_fsi_page_id(page), false);
+		auto* entries = reinterpret_cast<const uint8_t*>(frame.get_data());
+		for (; page < end; page++) {
+			uint8_t free_class = get_entry(entries, page);
+			if (free_class >= min_class) {
+				buffer_manager_.unfix_page(frame, false);
+				segment_page_id = page;
+				return true;
+			}
+			if (leading_full_pages && free_class == 0) {
+				first_candidate_ = page + 1;
+			} else {
+				leading_full_pages = false;
+			}
+		}
+		buffer_manager_.unfix_page(frame, false);
+	}
+	return false;
+}
+
+}  // namespace buzzdb
@@ -1,8 +1,14 @@
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 
 #include "heap/heap_file.h"
 #include "common/macros.h"
+#include "storage/tuple.h"
 
 namespace buzzdb {
 
@@ -145,37 +151,68 @@ HeapSegment::HeapSegment(uint16_t segment_id, LogManager &log_manager,
     : segment_id_(segment_id),
 	  log_manager_(log_manager),
 	  buffer_manager_(buffer_manager),
-	  page_count_(0){
+	  page_count_(0),
+	  fsi_(segment_id, buffer_manager.get_page_size() -
+			  sizeof(SlottedPage::Header), buffer_manager) {
 }
 
-TID HeapSegment::allocate(uint32_t record_size) {
+bool HeapSegment::try_allocate(uint64_t segment_page_id, uint32_t record_size,
+		TID &tid) {
+	uint64_t page_id =
+			BufferManager::get_overall_page_id(segment_id_, segment_page_id);
 
-	// Go over all pages in heap segment
-	// std::cout << "Go over all pages in heap segment \n";
+	BufferFrame &frame = buffer_manager_.fix_page(page_id, true);
 
-	for (size_t segment_page_itr = 0;
-			segment_page_itr < page_count_;
-			segment_page_itr++) {
+	auto* page = reinterpret_cast<SlottedPage*>(frame.get_data());
 
-		uint64_t page_id =
-				BufferManager::get_overall_page_id(segment_id_, segment_page_itr);
+	if(page->get_required_space(record_size) > page->header.free_space){
+		uint32_t free_space = page->header.free_space;
+		buffer_manager_.unfix_page(frame, false);
+		fsi_.update(segment_page_id, free_space);
+		return false;
+	}
 
-		BufferFrame &frame = buffer_manager_.fix_page(page_id, true);
+	// Reclaim the space of erased and shrunk records, once it is needed
+	if (page->get_required_space(record_size) > page->get_contiguous_space()) {
+		page->compactify(buffer_manager_.get_page_size());
+	}
 
-		auto* page = reinterpret_cast<SlottedPage*>(frame.get_data());
+	tid = page->addSlot(record_size);
+	uint32_t free_space = page->header.free_space;
+	buffer_manager_.unfix_page(frame, true);
+	fsi_.update(segment_page_id, free_space);
+	if (zone_map_) {
+		zone_map_->add_tuple(segment_page_id, zone_map_field_count_);
+	}
+	return true;
+}
 
-		if(record_size > page->header.free_space){
-			continue;
+TID HeapSegment::allocate(uint32_t record_size) {
+
+	// Ask the free-space inventory for a page with enough room for the record
+	// and a new slot
+	TID tid(0);
+	uint64_t segment_page_id;
+	while (fsi_.find(record_size + sizeof(SlottedPage::Slot), page_count_,
+			segment_page_id)) {
+		if (try_allocate(segment_page_id, record_size, tid)) {
+			return tid;
 		}
+	}
 
-		TID tid = page->addSlot(record_size);
-		buffer_manager_.unfix_page(frame, true);
+	// The inventory rounds the free space down, so the last page may still
+	// have room
+	if (page_count_ > 0 && try_allocate(page_count_ - 1, record_size, tid)) {
 		return tid;
 	}
 
 	// Did not find a free slot
 	// std::cout << "Did not find a free slot \n";
 
+	if (page_count_ == 0) {
+		truncate_zone_map();
+	}
+
 	uint64_t page_id =
 	      BufferManager::get_overall_page_id(segment_id_, page_count_);
 
@@ -189,56 +226,186 @@ TID HeapSegment::allocate(uint32_t record_size) {
 
 	page->header.overall_page_id = page_id;
 
-	TID tid = page->addSlot(record_size);
+	tid = page->addSlot(record_size);
+	uint32_t free_space = page->header.free_space;
 	buffer_manager_.unfix_page(frame, true);
+	segment_page_id = page_count_ - 1;
+	fsi_.add_page(segment_page_id, free_space);
+	if (zone_map_) {
+		zone_map_->reset_page(segment_page_id, zone_map_field_count_);
+		zone_map_->add_tuple(segment_page_id, zone_map_field_count_);
+	}
 
 	return tid;
 }
 
-uint32_t HeapSegment::read(TID tid, std::byte* record, uint32_t capacity) const {
-  uint64_t page_id = tid.value >> 16;
-  uint64_t overall_page_id =
-      BufferManager::get_overall_page_id(segment_id_, page_id);
-  uint16_t slot_id = tid.value & ((1ull << 16) - 1);
+void HeapSegment::bulk_append(const std::byte* records, uint32_t record_size,
+		uint64_t record_count) {
+	uint32_t page_size = buffer_manager_.get_page_size();
+	// The pages of a run are packed at the page size, which need not keep
+	// the page header aligned, so every page is built in a frame of its own
+	// and then copied into the run
+	FrameArena pages(page_size * BULK_PAGES, 1, false);
+	FrameArena scratch(page_size, 1, false);
+	PageSummary summary;
+	if (page_count_ == 0 && record_count > 0) {
+		truncate_zone_map();
+	}
 
-  BufferFrame& frame = buffer_manager_.fix_page(overall_page_id, false);
-  auto* page = reinterpret_cast<SlottedPage*>(frame.get_data());
+	uint64_t record = 0;
+	while (record < record_count) {
+		// Fill a run of pages
+		uint64_t first_page = page_count_;
+		uint64_t run_pages = 0;
+		for (; run_pages < BULK_PAGES && record < record_count; run_pages++) {
+			char* data = scratch.get_frame(0);
+			uint64_t segment_page_id = first_page + run_pages;
+			// The scratch frame is reused for every page, so clear what the
+			// previous page left in the gaps of the page
+			memset(data, 0, page_size);
+			auto* page = new (data) SlottedPage(data, page_size);
+			page->header.overall_page_id =
+					BufferManager::get_overall_page_id(segment_id_, segment_page_id);
+
+			summary.tuple_count = 0;
+			summary.min.assign(zone_map_field_count_,
+					std::numeric_limits<int>::max());
+			summary.max.assign(zone_map_field_count_,
+					std::numeric_limits<int>::min());
+			while (record < record_count &&
+					page->get_required_space(record_size) <=
+							page->header.free_space) {
+				const std::byte* source = records + record * record_size;
+				TID tid = page->addSlot(record_size);
+				uint16_t slot_id = tid.value & ((1ull << 16) - 1);
+				memcpy(data + page->getSlot(slot_id).get_offset(), source,
+						record_size);
+				for (uint16_t i = 0; i < zone_map_field_count_; i++) {
+					int field;
+					memcpy(&field, source + i * sizeof(int), sizeof(int));
+					summary.min[i] = std::min(summary.min[i], field);
+					summary.max[i] = std::max(summary.max[i], field);
+				}
+				summary.tuple_count++;
+				record++;
+			}
+			if (summary.tuple_count == 0) {
+				// Only happens for the first page, before anything is written
+				throw std::length_error("record does not fit into a page");
+			}
+
+			fsi_.add_page(segment_page_id, page->header.free_space);
+			if (zone_map_) {
+				zone_map_->set_summary(segment_page_id, zone_map_field_count_,
+						summary);
+			}
+			memcpy(pages.get_frame(0) + run_pages * page_size, data, page_size);
+		}
 
-//  std::cout << *page;
+		buffer_manager_.write_pages(segment_id_, first_page, pages.get_frame(0),
+				run_pages);
+		page_count_ += run_pages;
+	}
 
-  buzzdb::SlottedPage::Slot slot = page->getSlot(slot_id);
+	buffer_manager_.sync_segment(segment_id_);
+}
 
-  uint64_t value = slot.value;
-  uint32_t length = value << 40 >> 40;
-  uint32_t offset = value << 16 >> 40;
+void HeapSegment::enable_zone_map(uint16_t field_count) {
+	zone_map_.reset(new ZoneMap(segment_id_, buffer_manager_));
+	zone_map_field_count_ = field_count;
+}
 
-  if (capacity <= length) {
-    memcpy(record, &frame.get_data()[offset], capacity);
+void HeapSegment::truncate_zone_map() {
+	if (zone_map_) {
+		zone_map_->truncate(0);
+	} else {
+		ZoneMap(segment_id_, buffer_manager_).truncate(0);
+	}
+}
+
+uint32_t HeapSegment::read(TID tid, std::byte* record, uint32_t capacity) const {
+  BufferFrame& frame = fix_record(tid, false);
+  TupleView tuple = read_view(frame, tid);
+
+  if (capacity <= tuple.length) {
+    memcpy(record, tuple.data, capacity);
   } else {
     std::cout << "Capacity exceeds length \n";
-    std::cout << "Length: " << length << "\n";
+    std::cout << "Length: " << tuple.length << "\n";
     exit(0);
   }
 
   buffer_manager_.unfix_page(frame, false);
 
-  return length;
+  return tuple.length;
+}
+
+template <ColumnType T>
+void HeapSegment::read_column(uint64_t segment_page_id, const Schema &schema,
+    uint16_t column,
+    std::vector<typename ColumnTraits<T>::value_type> &values) const {
+  // Views of VARCHAR fields would point into the page after it is unfixed
+  static_assert(T != ColumnType::VARCHAR, "only fixed-width columns");
+  BufferFrame& frame = buffer_manager_.fix_page(
+      BufferManager::get_overall_page_id(segment_id_, segment_page_id), false);
+  auto* page = reinterpret_cast<SlottedPage*>(frame.get_data());
+  std::vector<const std::byte*> records;
+  for (auto tuple : *page) {
+    records.push_back(tuple.data);
+  }
+  values.resize(records.size());
+  gather_column<T>(schema, column, records.data(), records.size(),
+                   values.data());
+  buffer_manager_.unfix_page(frame, false);
+}
+
+template void HeapSegment::read_column<ColumnType::INT32>(uint64_t,
+    const Schema &, uint16_t, std::vector<int32_t> &) const;
+template void HeapSegment::read_column<ColumnType::INT64>(uint64_t,
+    const Schema &, uint16_t, std::vector<int64_t> &) const;
+
+TupleView HeapSegment::read_view(BufferFrame& frame, TID tid) const {
+  uint16_t slot_id = tid.value & ((1ull << 16) - 1);
+  auto* page = reinterpret_cast<SlottedPage*>(frame.get_data());
+  return page->get_tuple(slot_id);
+}
+
+BufferFrame& HeapSegment::fix_record(TID& tid, bool exclusive) const {
+  uint64_t overall_page_id =
+      BufferManager::get_overall_page_id(segment_id_, tid.value >> 16);
+  uint16_t slot_id = tid.value & ((1ull << 16) - 1);
+
+  BufferFrame* frame = &buffer_manager_.fix_page(overall_page_id, exclusive);
+  auto* page = reinterpret_cast<SlottedPage*>(frame->get_data());
+  SlottedPage::Slot slot = page->getSlot(slot_id);
+  if (slot.is_redirect()) {
+    // A record only moves once, the redirect is updated when it moves again
+    buffer_manager_.unfix_page(*frame, false);
+    tid = slot.get_redirect();
+    overall_page_id =
+        BufferManager::get_overall_page_id(segment_id_, tid.value >> 16);
+    frame = &buffer_manager_.fix_page(overall_page_id, exclusive);
+  }
+  return *frame;
 }
 
 uint32_t HeapSegment::write(TID tid, std::byte* record, uint32_t record_size, UNUSED_ATTRIBUTE uint64_t txn_id) {
 
+  BufferFrame& frame = fix_record(tid, true);
   uint64_t page_id = tid.value >> 16;
   uint64_t overall_page_id =
       BufferManager::get_overall_page_id(segment_id_, page_id);
   uint16_t slot_id = tid.value & ((1ull << 16) - 1);
 
-  BufferFrame& frame = buffer_manager_.fix_page(overall_page_id, true);
   auto* page = reinterpret_cast<SlottedPage*>(frame.get_data());
 
   buzzdb::SlottedPage::Slot slot = page->getSlot(slot_id);
   uint64_t value = slot.value;
 
   uint32_t offset = value << 16 >> 40;
+  if (slot.is_moved()) {
+    offset += SlottedPage::MOVED_PREFIX;
+  }
   
   // save before record
   std::vector<char> before_record;
@@ -250,12 +417,108 @@ uint32_t HeapSegment::write(TID tid, std::byte* record, uint32_t record_size, UN
 
   buffer_manager_.unfix_page(frame, true);
 
+  if (zone_map_) {
+    assert(record_size >= zone_map_field_count_ * sizeof(int));
+    std::vector<int> fields(zone_map_field_count_);
+    memcpy(fields.data(), record, fields.size() * sizeof(int));
+    zone_map_->add_values(page_id, fields.data(), zone_map_field_count_);
+  }
+
   // Add an update record
   log_manager_.log_update(txn_id, overall_page_id, record_size, offset, reinterpret_cast<std::byte *> (before_record.data()), record);
 
   return 0;
 }
 
+SlottedPage::Slot HeapSegment::erase_slot(TID tid) {
+  uint64_t segment_page_id = tid.value >> 16;
+  uint64_t overall_page_id =
+      BufferManager::get_overall_page_id(segment_id_, segment_page_id);
+  uint16_t slot_id = tid.value & ((1ull << 16) - 1);
+
+  BufferFrame& frame = buffer_manager_.fix_page(overall_page_id, true);
+  auto* page = reinterpret_cast<SlottedPage*>(frame.get_data());
+  SlottedPage::Slot slot = page->getSlot(slot_id);
+  page->erase(slot_id);
+  uint32_t free_space = page->header.free_space;
+  buffer_manager_.unfix_page(frame, true);
+
+  fsi_.update(segment_page_id, free_space);
+  if (zone_map_ && slot.is_record()) {
+    zone_map_->remove_tuple(segment_page_id, zone_map_field_count_);
+  }
+  return slot;
+}
+
+void HeapSegment::erase(TID tid) {
+  SlottedPage::Slot slot = erase_slot(tid);
+  if (slot.is_redirect()) {
+    erase_slot(slot.get_redirect());
+  }
+}
+
+void HeapSegment::resize(TID tid, uint32_t record_size) {
+  TID record_tid = tid;
+  BufferFrame& frame = fix_record(record_tid, true);
+  uint64_t segment_page_id = record_tid.value >> 16;
+  uint16_t slot_id = record_tid.value & ((1ull << 16) - 1);
+
+  auto* page = reinterpret_cast<SlottedPage*>(frame.get_data());
+  if (page->resize(slot_id, record_size, buffer_manager_.get_page_size())) {
+    uint32_t free_space = page->header.free_space;
+    buffer_manager_.unfix_page(frame, true);
+    fsi_.update(segment_page_id, free_space);
+    return;
+  }
+
+  // The record outgrows its page, so move it to another one
+  TupleView tuple = page->get_tuple(slot_id);
+  std::vector<std::byte> record(tuple.data, tuple.data + tuple.length);
+  buffer_manager_.unfix_page(frame, false);
+
+  TID target = allocate(record_size + SlottedPage::MOVED_PREFIX);
+  uint64_t target_page_id = target.value >> 16;
+  uint16_t target_slot_id = target.value & ((1ull << 16) - 1);
+  BufferFrame& target_frame = buffer_manager_.fix_page(
+      BufferManager::get_overall_page_id(segment_id_, target_page_id), true);
+  auto* target_page = reinterpret_cast<SlottedPage*>(target_frame.get_data());
+  target_page->set_moved(target_slot_id, tid);
+  uint32_t offset = target_page->getSlot(target_slot_id).get_offset() +
+      SlottedPage::MOVED_PREFIX;
+  memcpy(&target_frame.get_data()[offset], record.data(), record.size());
+  buffer_manager_.unfix_page(target_frame, true);
+
+  if (zone_map_ && record.size() >= zone_map_field_count_ * sizeof(int)) {
+    std::vector<int> fields(zone_map_field_count_);
+    memcpy(fields.data(), record.data(), fields.size() * sizeof(int));
+    zone_map_->add_values(target_page_id, fields.data(), zone_map_field_count_);
+  }
+
+  // Let the TID redirect to the new place. A record that was moved before is
+  // erased from its previous place, so that redirects never chain.
+  uint64_t home_page_id = tid.value >> 16;
+  uint16_t home_slot_id = tid.value & ((1ull << 16) - 1);
+  if (record_tid.value != tid.value) {
+    erase_slot(record_tid);
+  }
+  BufferFrame& home_frame = buffer_manager_.fix_page(
+      BufferManager::get_overall_page_id(segment_id_, home_page_id), true);
+  auto* home_page = reinterpret_cast<SlottedPage*>(home_frame.get_data());
+  bool was_record = home_page->getSlot(home_slot_id).is_record();
+  if (was_record) {
+    home_page->redirect(home_slot_id, target);
+  } else {
+    home_page->setSlot(home_slot_id, target.value);
+  }
+  uint32_t free_space = home_page->header.free_space;
+  buffer_manager_.unfix_page(home_frame, true);
+
+  fsi_.update(home_page_id, free_space);
+  if (zone_map_ && was_record) {
+    zone_map_->remove_tuple(home_page_id, zone_map_field_count_);
+  }
+}
+
 std::ostream &operator<<(std::ostream &os, HeapSegment const &s) {
 
 	for (size_t segment_page_itr = 0;
@@ -0,0 +1,85 @@
+#include "heap/pax_segment.h"
+
+#include <new>
+
+namespace buzzdb {
+
+PaxSegment::PaxSegment(uint16_t segment_id, uint16_t field_count,
+		BufferManager& buffer_manager)
+	: segment_id_(segment_id),
+	  field_count_(field_count),
+	  buffer_manager_(buffer_manager),
+	  page_count_(0) {
+}
+
+TID PaxSegment::append(const int* fields) {
+	if (page_count_ > 0) {
+		uint64_t page_id =
+				BufferManager::get_overall_page_id(segment_id_, page_count_ - 1);
+		BufferFrame& frame = buffer_manager_.fix_page(page_id, true);
+		auto* page = reinterpret_cast<PaxPage*>(frame.get_data());
+		if (!page->is_full()) {
+			TID tid = page->add_tuple(fields);
+			buffer_manager_.unfix_page(frame, true);
+			if (zone_map_) {
+				zone_map_->add_tuple(page_count_ - 1, field_count_);
+				zone_map_->add_values(page_count_ - 1, fields, field_count_);
+			}
+			return tid;
+		}
+		buffer_manager_.unfix_page(frame, false);
+	} else {
+		truncate_zone_map();
+	}
+
+	uint64_t page_id =
+			BufferManager::get_overall_page_id(segment_id_, page_count_);
+
+	// Bump up page count for next allocation
+	page_count_++;
+
+	BufferFrame& frame = buffer_manager_.fix_page(page_id, true);
+
+	auto* page = new (frame.get_data())
+			PaxPage(buffer_manager_.get_page_size(), field_count_);
+
+	page->header.overall_page_id = page_id;
+
+	TID tid = page->add_tuple(fields);
+	buffer_manager_.unfix_page(frame, true);
+	if (zone_map_) {
+		zone_map_->reset_page(page_count_ - 1, field_count_);
+		zone_map_->add_tuple(page_count_ - 1, field_count_);
+		zone_map_->add_values(page_count_ - 1, fields, field_count_);
+	}
+
+	return tid;
+}
+
+void PaxSegment::enable_zone_map() {
+	zone_map_.reset(new ZoneMap(segment_id_, buffer_manager_));
+}
+
+void PaxSegment::truncate_zone_map() {
+	if (zone_map_) {
+		zone_map_->truncate(0);
+	} else {
+		ZoneMap(segment_id_, buffer_manager_).truncate(0);
+	}
+}
+
+void PaxSegment::read(TID tid, int* fields) const {
+	uint64_t page_id = tid.value >> 16;
+	uint64_t overall_page_id =
+			BufferManager::get_overall_page_id(segment_id_, page_id);
+	uint16_t row = tid.value & ((1ull << 16) - 1);
+
+	BufferFrame& frame = buffer_manager_.fix_page(overall_page_id, false);
+	auto* page = reinterpret_cast<PaxPage*>(frame.get_data());
+	for (uint16_t field = 0; field < field_count_; field++) {
+		fields[field] = page->get_column(field)[row];
+	}
+	buffer_manager_.unfix_page(frame, false);
+}
+
+}  // namespace buzzdb
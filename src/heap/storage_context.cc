@@ -0,0 +1,19 @@
+#include "heap/storage_context.h"
+
+#include "common/macros.h"
+
+namespace buzzdb {
+
+StorageContext::StorageContext(size_t page_size, size_t page_count)
+	: log_file_(File::open_file(LOG_FILE_PATH.c_str(), File::WRITE,
+			File::IOMode::DSYNC)),
+	  log_manager_(new LogManager(log_file_.get())),
+	  buffer_manager_(page_size, page_count) {
+}
+
+StorageContext& StorageContext::get_default() {
+	static StorageContext context(BUFFER_PAGE_SIZE, BUFFER_PAGE_COUNT);
+	return context;
+}
+
+}  // namespace buzzdb
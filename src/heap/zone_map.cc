@@ -0,0 +1,178 @@
+#include "heap/zone_map.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace buzzdb {
+
+ZoneMap::ZoneMap(uint16_t heap_segment_id, BufferManager& buffer_manager)
+	: heap_segment_id_(heap_segment_id),
+	  buffer_manager_(buffer_manager) {
+	assert((heap_segment_id & SEGMENT_ID_BIT) == 0);
+}
+
+uint64_t ZoneMap::get_entries_per_page() const {
+	return (buffer_manager_.get_page_size() - sizeof(Header)) / sizeof(Entry);
+}
+
+uint64_t ZoneMap::get_zone_page_id(uint64_t segment_page_id) const {
+	return BufferManager::get_overall_page_id(get_segment_id(heap_segment_id_),
+			segment_page_id / get_entries_per_page());
+}
+
+ZoneMap::Entry* ZoneMap::find_entry(BufferFrame& frame,
+		uint64_t segment_page_id) const {
+	auto* header = reinterpret_cast<Header*>(frame.get_data());
+	// A page beyond the end of the file is read into a zeroed frame, so it
+	// lacks the magic. The page id also rejects a page that was formatted
+	// for another position.
+	if (header->magic != MAGIC ||
+			header->overall_page_id != get_zone_page_id(segment_page_id)) {
+		return nullptr;
+	}
+	uint64_t index = segment_page_id % get_entries_per_page();
+	if (index >= header->entry_count) {
+		return nullptr;
+	}
+	return reinterpret_cast<Entry*>(frame.get_data() + sizeof(Header)) + index;
+}
+
+ZoneMap::Entry* ZoneMap::fix_entry(uint64_t segment_page_id,
+		uint16_t field_count, bool reset, BufferFrame*& frame) {
+	uint64_t zone_page_id = get_zone_page_id(segment_page_id);
+	frame = &buffer_manager_.fix_page(zone_page_id, true);
+	auto* header = reinterpret_cast<Header*>(frame->get_data());
+	if (header->magic != MAGIC || header->overall_page_id != zone_page_id) {
+		header->overall_page_id = zone_page_id;
+		header->magic = MAGIC;
+		header->field_count = std::min(field_count, MAX_FIELDS);
+		header->entry_count = 0;
+	}
+	assert(header->field_count == std::min(field_count, MAX_FIELDS));
+
+	// Entries of pages without tuples are empty, so that scans skip them
+	auto* entries = reinterpret_cast<Entry*>(frame->get_data() + sizeof(Header));
+	uint64_t index = segment_page_id % get_entries_per_page();
+	if (reset) {
+		// Drops the entries of the page and the following ones, which belong
+		// to pages that were written before the page was allocated again
+		header->entry_count = std::min<uint64_t>(header->entry_count, index);
+	}
+	while (header->entry_count <= index) {
+		Entry& entry = entries[header->entry_count++];
+		entry.tuple_count = 0;
+		std::fill(entry.min, entry.min + MAX_FIELDS,
+				std::numeric_limits<int32_t>::max());
+		std::fill(entry.max, entry.max + MAX_FIELDS,
+				std::numeric_limits<int32_t>::min());
+	}
+	return entries + index;
+}
+
+void ZoneMap::reset_page(uint64_t segment_page_id, uint16_t field_count) {
+	BufferFrame* frame;
+	fix_entry(segment_page_id, field_count, true, frame);
+	buffer_manager_.unfix_page(*frame, true);
+}
+
+void ZoneMap::add_tuple(uint64_t segment_page_id, uint16_t field_count) {
+	BufferFrame* frame;
+	Entry* entry = fix_entry(segment_page_id, field_count, false, frame);
+	entry->tuple_count++;
+	buffer_manager_.unfix_page(*frame, true);
+}
+
+void ZoneMap::set_summary(uint64_t segment_page_id, uint16_t field_count,
+		const PageSummary& summary) {
+	BufferFrame* frame;
+	Entry* entry = fix_entry(segment_page_id, field_count, true, frame);
+	entry->tuple_count = summary.tuple_count;
+	for (size_t i = 0; i < std::min<size_t>(summary.min.size(), MAX_FIELDS);
+			i++) {
+		entry->min[i] = summary.min[i];
+		entry->max[i] = summary.max[i];
+	}
+	buffer_manager_.unfix_page(*frame, true);
+}
+
+void ZoneMap::remove_tuple(uint64_t segment_page_id, uint16_t field_count) {
+	BufferFrame* frame;
+	Entry* entry = fix_entry(segment_page_id, field_count, false, frame);
+	assert(entry->tuple_count > 0);
+	entry->tuple_count--;
+	buffer_manager_.unfix_page(*frame, true);
+}
+
+void ZoneMap::add_values(uint64_t segment_page_id, const int* fields,
+		uint16_t field_count) {
+	BufferFrame* frame;
+	Entry* entry = fix_entry(segment_page_id, field_count, false, frame);
+	for (uint16_t i = 0; i < std::min(field_count, MAX_FIELDS); i++) {
+		entry->min[i] = std::min(entry->min[i], fields[i]);
+		entry->max[i] = std::max(entry->max[i], fields[i]);
+	}
+	buffer_manager_.unfix_page(*frame, true);
+}
+
+void ZoneMap::truncate(uint64_t page_count) {
+	uint64_t entries_per_page = get_entries_per_page();
+	uint64_t index = page_count % entries_per_page;
+	// Zone map pages are formatted in the order of the heap pages, so the
+	// first one that is not formatted ends the zone map
+	for (uint64_t segment_page_id = page_count - index;;
+			segment_page_id += entries_per_page) {
+		uint64_t zone_page_id = get_zone_page_id(segment_page_id);
+		BufferFrame& frame = buffer_manager_.fix_page(zone_page_id, true);
+		auto* header = reinterpret_cast<Header*>(frame.get_data());
+		bool formatted = header->magic == MAGIC &&
+				header->overall_page_id == zone_page_id;
+		bool dropped = formatted && header->entry_count > index;
+		if (dropped) {
+			header->entry_count = index;
+		}
+		buffer_manager_.unfix_page(frame, dropped);
+		if (!formatted) {
+			break;
+		}
+		index = 0;
+	}
+}
+
+bool ZoneMap::get_summary(uint64_t segment_page_id, PageSummary& summary) {
+	BufferFrame& frame =
+			buffer_manager_.fix_page(get_zone_page_id(segment_page_id), false);
+	Entry* entry = find_entry(frame, segment_page_id);
+	if (entry != nullptr) {
+		auto field_count = reinterpret_cast<Header*>(frame.get_data())->field_count;
+		summary.tuple_count = entry->tuple_count;
+		summary.min.assign(entry->min, entry->min + field_count);
+		summary.max.assign(entry->max, entry->max + field_count);
+	}
+	buffer_manager_.unfix_page(frame, false);
+	return entry != nullptr;
+}
+
+bool ZoneMap::get_table_summary(uint64_t page_count, PageSummary& summary) {
+	summary.tuple_count = 0;
+	summary.min.clear();
+	summary.max.clear();
+	PageSummary page_summary;
+	for (uint64_t page = 0; page < page_count; page++) {
+		if (!get_summary(page, page_summary)) {
+			return false;
+		}
+		if (page == 0) {
+			summary.min = page_summary.min;
+			summary.max = page_summary.max;
+		}
+		for (size_t i = 0; i < summary.min.size(); i++) {
+			summary.min[i] = std::min(summary.min[i], page_summary.min[i]);
+			summary.max[i] = std::max(summary.max[i], page_summary.max[i]);
+		}
+		summary.tuple_count += page_summary.tuple_count;
+	}
+	return true;
+}
+
+}  // namespace buzzdb
@@ -7,21 +7,66 @@
 #include <vector>
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include "buffer/buffer_stats.h"
+#include "buffer/frame_arena.h"
+#include "buffer/page_table.h"
+#include "buffer/replacer.h"
+#include "storage/file.h"
 
 namespace buzzdb {
 
+class BufferRing;
+
 class BufferFrame {
 private:
     friend class BufferManager;
 
     uint64_t frame_id;
-    uint64_t page_id;
-    std::vector<char> data;
+    std::atomic<uint64_t> page_id;
+
+    /// The page data. Points into the frame arena of the buffer manager, or
+    /// into the memory mapping of a read-only segment.
+    char* data = nullptr;
+
+    /// Whether the frame belongs to a memory-mapped read-only segment
+    bool read_only = false;
+
+    /// Index of the buffer pool partition the frame belongs to
+    uint32_t partition = 0;
+
+    /// Ring that loaded the page. Reset when the page is fixed without the
+    /// ring, so that pages used by others are not recycled by the ring.
+    std::atomic<const BufferRing*> ring{nullptr};
+
+	std::atomic<bool> dirty;
+
+    /// Time (steady clock ticks) at which the page became dirty
+    std::atomic<int64_t> dirty_since{0};
+
+    /// Number of fixes that were not unfixed yet. Fixed pages are never
+    /// evicted.
+    std::atomic<uint64_t> fix_count{0};
+
+    /// Protects the page data. Held shared or exclusive between `fix_page()`
+    /// and `unfix_page()`.
+    std::shared_mutex latch;
+
+    /// Thread that holds `latch` exclusively. That thread may fix the page
+    /// again without blocking on itself.
+    std::atomic<std::thread::id> exclusive_owner;
 
-	bool dirty;
+    /// Number of nested fixes by `exclusive_owner`
+    uint32_t exclusive_depth = 0;
 
 public:
-    /// Returns a pointer to this page's data.
+    /// Returns a pointer to this page's data. The data of pages of
+    /// memory-mapped segments must not be modified.
     char* get_data();
     
 };
@@ -36,6 +81,82 @@ public:
 };
 
 
+class read_only_segment_error
+: public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "segment is mapped read-only";
+    }
+};
+
+
+/// Access strategy for large sequential scans. The pages that a scan loads
+/// through the ring are put into a small, fixed set of frames that is
+/// reused round-robin, instead of evicting the working set of the rest of
+/// the buffer pool. Hits are not recorded for the replacement policy.
+/// A ring is used by one scan at a time and is not thread-safe.
+class BufferRing {
+public:
+    /// Constructor.
+    /// @param[in] size Number of frames of the ring.
+    explicit BufferRing(size_t size = DEFAULT_SIZE)
+        : frames(size == 0 ? 1 : size, INVALID_FRAME_ID) {}
+
+    /// Returns the number of frames of the ring.
+    size_t size() const { return frames.size(); }
+
+    /// Twice the read-ahead window of `BufferManager`, so that a scan can
+    /// read ahead while it still holds the previous page
+    static constexpr size_t DEFAULT_SIZE = 64;
+
+private:
+    friend class BufferManager;
+
+    /// Frames of the ring, or INVALID_FRAME_ID for unused slots
+    std::vector<uint64_t> frames;
+
+    /// Slot that is reused next
+    size_t position = 0;
+};
+
+
+/// Settings of the background writer of a `BufferManager`
+struct BackgroundWriterOptions {
+    /// Time between two rounds of the writer
+    std::chrono::milliseconds interval{100};
+    /// Pages that have been dirty for longer are written in the next round
+    std::chrono::milliseconds max_dirty_age{1000};
+    /// When a larger fraction of the frames is dirty, the oldest dirty pages
+    /// are written until the fraction drops to half of it
+    double max_dirty_ratio = 0.25;
+    /// Maximum number of pages that are written in one round
+    size_t max_pages_per_round = 256;
+};
+
+
+/// Counters of the background writer of a `BufferManager`
+struct BackgroundWriterStats {
+    /// Number of rounds the writer ran
+    uint64_t rounds = 0;
+    /// Number of pages the writer wrote
+    uint64_t written_pages = 0;
+    /// Number of write requests the pages were coalesced into
+    uint64_t write_requests = 0;
+    /// Time the writer spent writing
+    std::chrono::nanoseconds write_time{0};
+    /// Number of dirty victims that `fix_page()` had to write itself
+    uint64_t foreground_writes = 0;
+    /// Number of rounds that failed to write pages
+    uint64_t write_errors = 0;
+
+    /// Returns the throughput of the writer while it was writing.
+    double get_pages_per_second() const {
+        double seconds = std::chrono::duration<double>(write_time).count();
+        return seconds > 0 ? written_pages / seconds : 0;
+    }
+};
+
+
 class BufferManager {
 
 public:
@@ -44,7 +165,13 @@ public:
     /// @param[in] page_size  Size in bytes that all pages will have.
     /// @param[in] page_count Maximum number of pages that should reside in
     //                        memory at the same time.
-    BufferManager(size_t page_size, size_t page_count);
+    /// @param[in] policy     Policy that selects the pages to evict when
+    ///                       the buffer is full.
+    /// @param[in] partition_count Number of partitions the frames are split
+    ///                       into. 0 creates one partition per NUMA node.
+    BufferManager(size_t page_size, size_t page_count,
+                  ReplacementPolicy policy = ReplacementPolicy::TWO_Q,
+                  size_t partition_count = 0);
 
     /// Destructor. Writes all dirty pages to disk.
     ~BufferManager();
@@ -55,28 +182,72 @@ public:
     /// Returns a reference to a `BufferFrame` object for a given page id. When
     /// the page is not loaded into memory, it is read from disk. Otherwise the
     /// loaded page is used.
-    /// When the page cannot be loaded because the buffer is full, throws the
-    /// exception `buffer_full_error`.
+    /// When the buffer is full, an unfixed page is evicted according to the
+    /// replacement policy; dirty victims are written back first. When all
+    /// pages are fixed, throws the exception `buffer_full_error`.
     /// Is thread-safe w.r.t. other concurrent calls to `fix_page()` and
     /// `unfix_page()`.
     /// @param[in] page_id   Page id of the page that should be loaded.
     /// @param[in] exclusive If `exclusive` is true, the page is locked
     ///                      exclusively. Otherwise it is locked
-    ///                      non-exclusively (shared).
-    BufferFrame& fix_page(uint64_t page_id, bool exclusive);
+    ///                      non-exclusively (shared). A thread that holds
+    ///                      a page exclusively may fix it again; nested
+    ///                      fixes of a shared page must be shared as well.
+    /// @param[in] ring      Ring of a large scan. When set, a page that is
+    ///                      not in memory is loaded into a frame of the ring.
+    BufferFrame& fix_page(uint64_t page_id, bool exclusive,
+                          BufferRing* ring = nullptr);
+
+    /// Fixes several pages at once like `fix_page()`. All pages that are not
+    /// in memory are read with one batch of asynchronous requests. The pages
+    /// must be distinct. Returns the frames in the order of `page_ids`; each
+    /// of them has to be unfixed with `unfix_page()`.
+    std::vector<BufferFrame*> fix_pages(const std::vector<uint64_t>& page_ids,
+                                        bool exclusive);
+
+    /// Reads the given pages of a segment into memory without fixing them,
+    /// so that later fixes do not have to wait for the disk. Pages that are
+    /// in memory already or lie beyond the end of the segment file are
+    /// skipped, at most the read-ahead window of `fix_page()` is read, and
+    /// the prefetch stops early when the buffer is full.
+    /// When `fix_page()` notices that the pages of a segment are accessed
+    /// sequentially, it reads ahead on its own.
+    /// Is thread-safe.
+    /// @param[in] segment_id            The segment.
+    /// @param[in] first_segment_page_id Segment page id of the first page.
+    /// @param[in] page_count            Number of pages to read.
+    /// @param[in] ring                  Ring of the scan that prefetches, if
+    ///                                  any. At most half of the ring is
+    ///                                  prefetched at once.
+    void prefetch_pages(uint16_t segment_id, uint64_t first_segment_page_id,
+                        size_t page_count, BufferRing* ring = nullptr);
+
+    /// Switches the segment to read-only access through a memory mapping of
+    /// its file. Afterwards, shared fixes of its pages return frames that
+    /// point directly into the mapping, without copying the page into the
+    /// pool; exclusive fixes and dirty unfixes throw
+    /// `read_only_segment_error`. Pages of the segment that are in the pool
+    /// are written back and dropped first.
+    /// Must not be called while pages of the segment are fixed.
+    /// @param[in] segment_id The segment.
+    /// @param[in] advice     Expected access pattern of the segment.
+    void map_segment(uint16_t segment_id,
+                     File::AccessAdvice advice = File::AccessAdvice::SEQUENTIAL);
 
     /// Takes a `BufferFrame` reference that was returned by an earlier call to
     /// `fix_page()` and unfixes it. When `is_dirty` is / true, the page is
     /// written back to disk eventually.
+    /// Releases the latch acquired by `fix_page()`.
     void unfix_page(BufferFrame& page, bool is_dirty);
 
     /// Returns the page ids of all pages (fixed and unfixed) that are in the
-    /// FIFO list in FIFO order.
+    /// FIFO list in FIFO order. For LRU-K these are the pages with fewer than
+    /// K accesses, for CLOCK all pages in clock order.
     /// Is not thread-safe.
     std::vector<uint64_t> get_fifo_list() const;
 
     /// Returns the page ids of all pages (fixed and unfixed) that are in the
-    /// LRU list in LRU order.
+    /// LRU list in LRU order. Is empty for CLOCK.
     /// Is not thread-safe.
     std::vector<uint64_t> get_lru_list() const;
 
@@ -99,27 +270,339 @@ public:
         return (static_cast<uint64_t>(segment_id) << 48) | segment_page_id;
     }
 
+    /// Writes the page to disk if it is in the buffer and dirty, and waits
+    /// until the write is durable. Throws the first error of the background
+    /// writer since the last flush, if there was one.
+    /// Is thread-safe.
     void  flush_page(uint64_t page_id);
 
+    /// Drops the page from the buffer without writing it back. The page must
+    /// not be fixed.
+    /// Is thread-safe.
     void  discard_page(uint64_t page_id);
 
+    /// Writes consecutive pages of a segment straight to the segment file
+    /// with one request, bypassing the buffer. Copies of the pages in the
+    /// buffer are dropped, so they must not be fixed. The writes become
+    /// durable with `sync_segment()`.
+    /// Is thread-safe w.r.t. accesses to other pages.
+    /// @param[in] segment_id            The segment.
+    /// @param[in] first_segment_page_id Segment page id of the first page.
+    /// @param[in] pages                 The data of the pages. Must be
+    ///                                  aligned like the frames of a
+    ///                                  `FrameArena`, for direct I/O.
+    /// @param[in] page_count            Number of pages to write.
+    void write_pages(uint16_t segment_id, uint64_t first_segment_page_id,
+            char* pages, size_t page_count);
+
+    /// Makes all writes to the segment file durable.
+    /// Is thread-safe.
+    void sync_segment(uint16_t segment_id);
+
+    /// Writes all dirty pages to disk. Each segment file that was written to
+    /// is synced once at the end. Throws the first error of the background
+    /// writer since the last flush, if there was one.
+    /// Is thread-safe.
     void  flush_all_pages();
 
+    /// Drops all pages from the buffer without writing them back.
+    /// Is not thread-safe, except w.r.t. the background writer.
     void  discard_all_pages();
 
+    /// Starts a thread that writes dirty pages in the background, so that
+    /// flushes and evictions rarely have to write many pages at once. The
+    /// writer runs in rounds; each round writes the pages that have been
+    /// dirty for too long and, when too many frames are dirty, the oldest
+    /// dirty pages. Adjacent pages of a segment are written together.
+    /// Pages that are fixed exclusively are skipped. Does nothing when the
+    /// writer is already running.
+    void start_background_writer(
+            const BackgroundWriterOptions& options = BackgroundWriterOptions());
+
+    /// Stops the background writer and waits for its current round. The
+    /// destructor stops the writer as well.
+    void stop_background_writer();
+
+    /// Returns the counters of the background writer.
+    /// Is thread-safe.
+    BackgroundWriterStats get_background_writer_stats() const;
+
+    /// Returns the counters of the whole buffer pool.
+    /// Is thread-safe.
+    BufferStatsSnapshot get_stats() const;
+
+    /// Returns the counters of one segment. Only misses, prefetched pages and
+    /// reads and writes are counted per segment, so that hits stay cheap.
+    /// Is thread-safe.
+    BufferStatsSnapshot get_segment_stats(uint16_t segment_id);
+
+    /// Sets all counters to zero.
+    /// Is thread-safe.
+    void reset_stats();
+
+    /// Times every `period`-th fix of each thread for the fix latency
+    /// histogram. Timing costs two clock reads per timed fix, so it is off
+    /// (a period of 0) by default.
+    /// Is thread-safe.
+    void set_fix_latency_period(uint32_t period);
+
+    /// Maximum number of page requests that are in flight at the same time
+    /// during batched I/O
+    static constexpr size_t MAX_IO_BATCH = 64;
+
+    /// Number of pages that are read ahead when a sequential access pattern
+    /// is detected. At most a quarter of the pool is used for read-ahead.
+    static constexpr size_t READ_AHEAD_PAGES = 32;
+
     /// Returns the frame id of the frame containing the page if it is
     /// present in the buffer
     /// Otherwise, returns INVALID_FRAME_ID
     uint64_t get_frame_id_of_page(uint64_t page_id);
 
+    /// Number of consecutive pages of a segment that belong to the same
+    /// partition
+    static constexpr uint64_t PARTITION_EXTENT_PAGES = 64;
+
+    /// Returns the number of partitions of the pool.
+    size_t get_partition_count() const { return partitions_.size(); }
+
+    /// Returns the partition whose frames hold the page. Pages are assigned
+    /// to partitions by hashing extents of `PARTITION_EXTENT_PAGES` pages.
+    /// When all frames of the partition are fixed, the page is loaded into
+    /// a frame of another partition instead.
+    size_t get_partition_of_page(uint64_t page_id) const;
+
+    /// Returns the partition whose memory is local to the NUMA node the
+    /// calling thread runs on. Workers can use it to prefer pages whose
+    /// partition is local.
+    size_t get_local_partition() const;
+
 private:
-    size_t capacity_;
+    size_t capacity_ = 0;
+
+	size_t page_size_ = 0;
+
+    /// Descriptors of all frames, indexed by frame id
+    std::unique_ptr<BufferFrame[]> pool_;
+
+    /// Maps the pages in the buffer to their frames
+    PageTable page_table_;
+
+    ReplacementPolicy policy_ = ReplacementPolicy::TWO_Q;
+
+    /// A contiguous range of frames with its own memory, free list and
+    /// replacer. The pages of a partition are loaded into its frames, so
+    /// partitions do not contend for loads and evictions. Only when all of
+    /// its frames are fixed, a page borrows a frame of another partition.
+    struct Partition {
+        /// Id of the first frame of the partition
+        uint64_t first_frame_id = 0;
+
+        size_t frame_count = 0;
+
+        /// NUMA node of the frame memory, or -1 when it is not bound
+        int numa_node = -1;
+
+        /// Holds the data of the frames
+        std::unique_ptr<FrameArena> arena;
+
+        /// Frames that do not hold a page
+        std::vector<uint64_t> free_frames;
+
+        /// Selects the victims for eviction. Uses frame ids relative to
+        /// `first_frame_id`.
+        std::unique_ptr<Replacer> replacer;
+
+        /// Protects `replacer`
+        std::mutex replacer_mutex;
+
+        /// Serializes page loads, evictions and discards within the
+        /// partition. Protects `free_frames`. Lookups of resident pages only
+        /// lock the page table.
+        std::mutex load_mutex;
+    };
+
+    std::vector<std::unique_ptr<Partition>> partitions_;
+
+    /// I/O mode of the segment files. Writes become durable when the file is
+    /// synced in `flush_page()`, `flush_all_pages()` or the destructor, not
+    /// on every eviction.
+    File::IOMode io_mode_ = File::IOMode::BUFFERED;
+
+    /// Returns the partition of the frame.
+    Partition& get_frame_partition(const BufferFrame& frame) const {
+        return *partitions_[frame.partition];
+    }
+
+    /// Records an access of the page in the frame for the replacement
+    /// policy.
+    void record_access(const BufferFrame& frame);
+
+    /// State of a segment that was accessed through the buffer manager
+    struct Segment {
+        /// The segment file, kept open for the lifetime of the buffer
+        /// manager
+        std::unique_ptr<File> file;
+
+        /// The page whose miss continues a sequential access pattern
+        std::atomic<uint64_t> next_sequential_page{0};
+
+        /// Whether the segment is served from a read-only memory mapping
+        bool mapped = false;
+
+        /// One frame per page of a mapped segment, pointing into the mapping
+        std::vector<std::unique_ptr<BufferFrame>> mapped_frames;
+
+        /// Counters of the accesses to the segment
+        BufferStats stats;
+    };
+
+    /// Counters of the whole pool
+    BufferStats stats_;
+
+    /// Every how many fixes of a thread one is timed, 0 for none
+    std::atomic<uint32_t> fix_latency_period_{0};
+
+    /// Counts reads or writes of pages of the segment.
+    void count_io(uint16_t segment_id, File::IORequest::Type type,
+                  size_t page_count);
+
+    /// Number of segments that are memory-mapped. Fixes only look for a
+    /// mapping when this is not zero.
+    std::atomic<size_t> mapped_segment_count_{0};
+
+    /// Fixes a page of a memory-mapped segment.
+    BufferFrame& fix_mapped_page(Segment& segment, uint64_t page_id,
+                                 bool exclusive);
+
+    /// All segments that were accessed so far, keyed by segment id
+    std::unordered_map<uint16_t, std::unique_ptr<Segment>> segments_;
+
+    /// Protects `segments_`
+    std::shared_mutex segments_mutex_;
+
+    /// Returns the segment and opens its file on first use.
+    /// Is thread-safe.
+    Segment& get_segment(uint16_t segment_id);
+
+    /// Returns the file of the segment.
+    /// Is thread-safe.
+    File& get_segment_file(uint16_t segment_id) {
+        return *get_segment(segment_id).file;
+    }
+
+    /// Claims frames for those pages of the range that are neither in memory
+    /// nor beyond the end of the segment file, and appends them to `loads`.
+    /// Stops early when the buffer is full.
+    void claim_read_ahead(uint16_t segment_id, uint64_t first_segment_page_id,
+                          size_t page_count, std::vector<uint64_t>& loads,
+                          BufferRing* ring);
+
+    /// Returns the number of pages read ahead at once.
+    size_t get_read_ahead_window() const;
 
-	size_t page_size_;
+    /// Reads or writes the pages of the frames with asynchronous requests
+    /// and waits for all of them. Sorts `frame_ids` by page id.
+    void transfer_frames(std::vector<uint64_t>& frame_ids,
+                         File::IORequest::Type type);
+
+    /// Fixes the frame of the page without latching it. When the page is not
+    /// in memory, a frame is claimed for it instead: it is added to the page
+    /// table, latched exclusively and `claimed` is set. The caller then has
+    /// to read the page and call `finish_load()` or `abort_load()`.
+    /// With a ring, the claimed frame is taken from the ring.
+    uint64_t pin_or_claim_page(uint64_t page_id, bool& claimed,
+                               BufferRing* ring = nullptr);
+
+    /// Makes a claimed frame evictable and latches it as requested.
+    void finish_load(BufferFrame& frame, bool exclusive);
+
+    /// Frees a claimed frame whose page could not be read.
+    void abort_load(BufferFrame& frame);
+
+    /// Fixes the frame of a resident page without latching it. Returns
+    /// INVALID_FRAME_ID when the page is not in the buffer.
+    uint64_t pin_resident_page(uint64_t page_id);
+
+    /// Acquires the latch of the frame.
+    void lock_frame(BufferFrame& frame, bool exclusive);
+
+    /// Releases the latch acquired by `lock_frame()`.
+    void unlock_frame(BufferFrame& frame);
+
+    /// Writes the frame to disk if it is dirty and returns whether it was
+    /// written. Does not sync the file. The frame must be fixed.
+    bool flush_frame(BufferFrame& frame);
+
+    /// Writes the pages of the fixed and latched frames. Pages that are
+    /// adjacent in their segment are copied together and written with one
+    /// request. Sorts `frame_ids` by page id. Returns the number of
+    /// requests.
+    size_t write_frames(std::vector<uint64_t>& frame_ids);
+
+    /// Runs one round of the background writer.
+    void run_writer_round();
+
+    std::thread writer_thread_;
+
+    /// Held by the background writer during a round. Protects
+    /// `writer_options_` and `stop_writer_`.
+    std::mutex writer_mutex_;
+
+    /// Wakes the background writer up early
+    std::condition_variable writer_wakeup_;
+
+    BackgroundWriterOptions writer_options_;
+
+    bool stop_writer_ = false;
+
+    std::atomic<uint64_t> writer_rounds_{0};
+    std::atomic<uint64_t> writer_written_pages_{0};
+    std::atomic<uint64_t> writer_write_requests_{0};
+    std::atomic<int64_t> writer_write_time_{0};
+    std::atomic<uint64_t> foreground_writes_{0};
+    std::atomic<uint64_t> writer_write_errors_{0};
+
+    /// First error of the background writer that no flush reported yet
+    std::exception_ptr writer_error_;
+    /// Protects `writer_error_`
+    std::mutex writer_error_mutex_;
+
+    /// Throws and clears `writer_error_`, if it is set.
+    void rethrow_writer_error();
+
+    /// Returns a frame of the partition that can be loaded with a new page.
+    /// Takes a free frame if there is one, otherwise evicts a page.
+    /// Must be called with the `load_mutex` of the partition held, and with
+    /// the one of `home`, the partition of the page that is loaded.
+    uint64_t get_free_frame(Partition& partition, Partition& home);
+
+    /// Returns a frame of another partition than `home` when all frames of
+    /// `home` are fixed. Must be called with the `load_mutex` of `home`
+    /// held, `remote_guard` receives the one of the other partition.
+    /// Throws `buffer_full_error` if no partition has a frame to spare.
+    uint64_t get_remote_frame(size_t home,
+            std::unique_lock<std::mutex>& remote_guard);
+
+    /// Like `get_free_frame()`, but reuses the next frame of the ring when
+    /// it still holds an unfixed page that was loaded through the ring.
+    /// Otherwise the new frame replaces that frame in the ring.
+    uint64_t get_ring_frame(Partition& partition, BufferRing& ring);
+
+    /// Removes the page of the frame from the page table if the frame is not
+    /// fixed, and returns whether it did. The check happens under the lock
+    /// of the page table shard, so nobody can fix the page concurrently.
+    bool try_unmap_frame(BufferFrame& frame);
+
+    /// Writes back the page of an unmapped frame if it is dirty and resets
+    /// the frame.
+    void evict_frame(uint64_t frame_id);
 
-    std::vector<std::unique_ptr<BufferFrame>> pool_;
+    /// Marks all frames of the partition as free.
+    void reset_free_frames(Partition& partition);
 
-    uint64_t page_counter_ = 0;
+    /// Resets a frame so that it can hold another page.
+    void reset_frame(uint64_t frame_id);
 
     void read_frame(uint64_t frame_id);
 
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace buzzdb {
+
+/// Events that the buffer manager counts
+enum class BufferCounter {
+    /// Fixes of pages that were in memory
+    HITS,
+    /// Fixes of pages that had to be read
+    MISSES,
+    /// Pages that were read ahead of their first fix
+    PREFETCHED_PAGES,
+    /// Pages that were evicted to make room for another page
+    EVICTIONS,
+    /// Evicted pages that had to be written first
+    DIRTY_EVICTIONS,
+    /// Frames of a `BufferRing` that were reused for the next page of a scan
+    RING_REUSES,
+    /// Pages that were loaded into a frame of another partition because all
+    /// frames of their own were fixed
+    REMOTE_FRAMES,
+    READ_PAGES,
+    READ_BYTES,
+    WRITTEN_PAGES,
+    WRITTEN_BYTES,
+    /// Fixes that had to wait for the latch of the page
+    LATCH_WAITS,
+    /// Total time spent waiting for latches, in nanoseconds
+    LATCH_WAIT_NANOSECONDS,
+    COUNT
+};
+
+
+/// Values of all counters at one point in time
+struct BufferStatsSnapshot {
+    /// Number of buckets of the fix latency histogram. Bucket i counts the
+    /// fixes that took less than 2^i nanoseconds (and at least 2^(i-1)).
+    static constexpr size_t LATENCY_BUCKETS = 40;
+
+    std::array<uint64_t, static_cast<size_t>(BufferCounter::COUNT)> counters{};
+
+    std::array<uint64_t, LATENCY_BUCKETS> fix_latency{};
+
+    /// Returns the value of the counter.
+    uint64_t get(BufferCounter counter) const {
+        return counters[static_cast<size_t>(counter)];
+    }
+
+    /// Returns the fraction of fixes that were hits.
+    double get_hit_ratio() const;
+
+    /// Returns an upper bound of the fix latency of the given percentile
+    /// (between 0 and 100).
+    std::chrono::nanoseconds get_fix_latency_percentile(double percentile) const;
+};
+
+
+/// Counters of buffer manager events. Updates are cheap and scale with the
+/// number of threads: every thread updates its own shard of counters,
+/// `snapshot()` sums up all shards.
+class BufferStats {
+
+public:
+    /// Adds `value` to the counter.
+    /// Is thread-safe.
+    void add(BufferCounter counter, uint64_t value = 1) {
+        get_shard().counters[static_cast<size_t>(counter)].fetch_add(
+                value, std::memory_order_relaxed);
+    }
+
+    /// Adds a fix that took `latency` to the latency histogram.
+    /// Is thread-safe.
+    void add_fix_latency(std::chrono::nanoseconds latency);
+
+    /// Returns the current values of all counters. Concurrent updates may
+    /// or may not be included.
+    /// Is thread-safe.
+    BufferStatsSnapshot snapshot() const;
+
+    /// Sets all counters to zero.
+    /// Is thread-safe, but concurrent updates may get lost.
+    void reset();
+
+    static constexpr size_t SHARD_COUNT = 16;
+
+private:
+    /// The counters of a group of threads, on separate cache lines
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>,
+                   static_cast<size_t>(BufferCounter::COUNT)> counters{};
+        std::array<std::atomic<uint64_t>,
+                   BufferStatsSnapshot::LATENCY_BUCKETS> fix_latency{};
+    };
+
+    /// Returns the shard of the calling thread.
+    Shard& get_shard();
+
+    std::array<Shard, SHARD_COUNT> shards_;
+};
+
+}  // namespace buzzdb
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace buzzdb {
+
+/// One contiguous, page-aligned memory region that holds the data of all
+/// frames of the buffer pool. Every frame starts at a multiple of
+/// `ALIGNMENT`, so frames can be the target of direct I/O. Large arenas are
+/// backed by huge pages when the system provides them, which reduces TLB
+/// misses when the pool is scanned.
+class FrameArena {
+
+public:
+    /// Alignment of the arena and of every frame in it. Matches the logical
+    /// block size that O_DIRECT requires.
+    static constexpr size_t ALIGNMENT = 4096;
+
+    /// Size of a huge page.
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    /// Constructor. The memory is zero-initialized.
+    /// @param[in] frame_size  Size in bytes of one frame.
+    /// @param[in] frame_count Number of frames.
+    /// @param[in] huge_pages  Whether huge pages should be used. Falls back
+    ///                        to regular pages when none are available.
+    /// @param[in] numa_node   NUMA node whose memory should be used, or -1
+    ///                        for the default policy of the process.
+    FrameArena(size_t frame_size, size_t frame_count, bool huge_pages = true,
+               int numa_node = -1);
+
+    /// Destructor.
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /// Returns the data of the frame.
+    char* get_frame(uint64_t frame_id) const {
+        return base_ + frame_id * stride_;
+    }
+
+    /// Returns the distance in bytes between the starts of adjacent frames.
+    size_t get_stride() const { return stride_; }
+
+    /// Returns whether the arena is backed by explicitly reserved huge
+    /// pages.
+    bool uses_huge_pages() const { return huge_pages_; }
+
+    /// Zeroes all frames and returns their physical memory to the system.
+    void clear();
+
+private:
+    char* base_ = nullptr;
+
+    size_t stride_ = 0;
+
+    /// Size of the mapping
+    size_t size_ = 0;
+
+    bool huge_pages_ = false;
+};
+
+}  // namespace buzzdb
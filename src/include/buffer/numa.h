@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+namespace buzzdb {
+namespace numa {
+
+/// Returns the number of NUMA nodes of the machine, or 1 when the machine
+/// has no NUMA topology information.
+size_t get_node_count();
+
+/// Returns the NUMA node the calling thread is running on, or 0 when it
+/// cannot be determined.
+int get_current_node();
+
+/// Asks the kernel to allocate the pages of the memory range, which must
+/// not be touched yet, on the given node. Falls back to other nodes when
+/// the node runs out of memory. Returns whether the policy was set.
+bool prefer_node(void* memory, size_t size, int node);
+
+}  // namespace numa
+}  // namespace buzzdb
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "common/macros.h"
+
+namespace buzzdb {
+
+/// Maps the ids of all pages that currently reside in the buffer to the id
+/// of the frame that holds them.
+/// The table is split into shards that are protected by their own mutex, so
+/// concurrent lookups of different pages rarely contend with each other.
+class PageTable {
+
+public:
+    /// Constructor.
+    /// @param[in] capacity    Expected number of entries (number of frames).
+    /// @param[in] shard_count Number of independently locked shards.
+    explicit PageTable(size_t capacity = 0,
+                       size_t shard_count = DEFAULT_SHARD_COUNT);
+
+    /// Returns the frame id of the page, or INVALID_FRAME_ID when the page is
+    /// not in the table.
+    /// Is thread-safe.
+    uint64_t find(uint64_t page_id) const;
+
+    /// Like `find()`, but calls `on_hit(frame_id)` while the shard of the
+    /// page is still locked, e.g. to fix the frame before it can be evicted.
+    /// Is thread-safe.
+    template <typename Callback>
+    uint64_t find(uint64_t page_id, Callback&& on_hit) const {
+        Shard& shard = get_shard(page_id);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        auto entry = shard.frames.find(page_id);
+        if (entry == shard.frames.end()) {
+            return INVALID_FRAME_ID;
+        }
+        on_hit(entry->second);
+        return entry->second;
+    }
+
+    /// Removes the mapping of the page if `predicate(frame_id)` returns true
+    /// while the shard of the page is locked. Returns whether the mapping was
+    /// removed.
+    /// Is thread-safe.
+    template <typename Predicate>
+    bool erase_if(uint64_t page_id, Predicate&& predicate) {
+        Shard& shard = get_shard(page_id);
+        std::lock_guard<std::mutex> guard(shard.mutex);
+        auto entry = shard.frames.find(page_id);
+        if (entry == shard.frames.end() || !predicate(entry->second)) {
+            return false;
+        }
+        shard.frames.erase(entry);
+        return true;
+    }
+
+    /// Adds a mapping from `page_id` to `frame_id`. An existing mapping of
+    /// the page is replaced.
+    /// Is thread-safe.
+    void insert(uint64_t page_id, uint64_t frame_id);
+
+    /// Removes the mapping of the page if there is one.
+    /// Is thread-safe.
+    void erase(uint64_t page_id);
+
+    /// Removes all mappings.
+    /// Is not thread-safe.
+    void clear();
+
+    static constexpr size_t DEFAULT_SHARD_COUNT = 16;
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<uint64_t, uint64_t> frames;
+    };
+
+    /// Returns the shard responsible for the page.
+    Shard& get_shard(uint64_t page_id) const;
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+};
+
+}  // namespace buzzdb
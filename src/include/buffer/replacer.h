@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace buzzdb {
+
+/// The page replacement policies that are supported by the buffer manager.
+enum class ReplacementPolicy {
+    TWO_Q,   // FIFO queue for pages seen once, LRU queue for hot pages
+    LRU_K,   // evicts the page with the largest backward K-distance
+    CLOCK    // clock sweep with saturating usage counts
+};
+
+/// Decides which frame of the buffer pool is evicted next.
+/// A replacer only knows frame ids; the buffer manager tells it when frames
+/// are loaded, accessed and emptied.
+/// Is not thread-safe; the buffer manager serializes all calls.
+class Replacer {
+
+public:
+    virtual ~Replacer() = default;
+
+    /// Called after a frame was loaded with a new page.
+    virtual void record_insert(uint64_t frame_id) = 0;
+
+    /// Called when the page of a frame is accessed again.
+    virtual void record_access(uint64_t frame_id) = 0;
+
+    /// Called when a frame no longer holds a page.
+    virtual void remove(uint64_t frame_id) = 0;
+
+    /// Selects and removes a victim among the tracked frames for which
+    /// `is_evictable` returns true. The callback is invoked in eviction order
+    /// and may claim the frame for the caller when it returns true.
+    /// Returns INVALID_FRAME_ID when there is no such frame.
+    virtual uint64_t pick_victim(
+            const std::function<bool(uint64_t)>& is_evictable) = 0;
+
+    /// Returns the frames of the policy's admission queue in eviction order.
+    virtual std::vector<uint64_t> get_fifo_list() const = 0;
+
+    /// Returns the frames of the policy's main queue in eviction order.
+    virtual std::vector<uint64_t> get_lru_list() const = 0;
+
+    /// Creates a replacer for a pool with `capacity` frames.
+    static std::unique_ptr<Replacer> make_replacer(ReplacementPolicy policy,
+                                                   size_t capacity);
+};
+
+
+/// 2Q: Pages enter a FIFO queue on their first access and are promoted to an
+/// LRU queue when they are accessed again. Victims are taken from the FIFO
+/// queue first.
+class TwoQReplacer : public Replacer {
+
+public:
+    explicit TwoQReplacer(size_t capacity);
+
+    void record_insert(uint64_t frame_id) override;
+    void record_access(uint64_t frame_id) override;
+    void remove(uint64_t frame_id) override;
+    uint64_t pick_victim(
+            const std::function<bool(uint64_t)>& is_evictable) override;
+    std::vector<uint64_t> get_fifo_list() const override;
+    std::vector<uint64_t> get_lru_list() const override;
+
+private:
+    enum class Queue { NONE, FIFO, LRU };
+
+    struct Entry {
+        Queue queue = Queue::NONE;
+        std::list<uint64_t>::iterator position;
+    };
+
+    std::list<uint64_t> fifo_;
+    std::list<uint64_t> lru_;
+    std::vector<Entry> entries_;
+};
+
+
+/// LRU-K: Evicts the frame whose K-th most recent access lies furthest in
+/// the past. Frames with fewer than K accesses are evicted first, in the
+/// order of their oldest access.
+class LRUKReplacer : public Replacer {
+
+public:
+    explicit LRUKReplacer(size_t capacity, size_t k = 2);
+
+    void record_insert(uint64_t frame_id) override;
+    void record_access(uint64_t frame_id) override;
+    void remove(uint64_t frame_id) override;
+    uint64_t pick_victim(
+            const std::function<bool(uint64_t)>& is_evictable) override;
+    std::vector<uint64_t> get_fifo_list() const override;
+    std::vector<uint64_t> get_lru_list() const override;
+
+private:
+    /// (has K accesses, K-th most recent access or oldest access, frame id)
+    using Key = std::tuple<bool, uint64_t, uint64_t>;
+
+    struct Entry {
+        bool tracked = false;
+        /// Most recent accesses, oldest first; holds at most K timestamps
+        std::vector<uint64_t> history;
+    };
+
+    Key get_key(uint64_t frame_id) const;
+
+    size_t k_;
+    uint64_t current_timestamp_ = 0;
+    std::vector<Entry> entries_;
+    std::set<Key> eviction_order_;
+};
+
+
+/// CLOCK-sweep: A hand sweeps over the frames and decrements their usage
+/// count; the first evictable frame with a usage count of zero is the
+/// victim. Accesses increment the usage count up to MAX_USAGE_COUNT.
+class ClockReplacer : public Replacer {
+
+public:
+    explicit ClockReplacer(size_t capacity);
+
+    void record_insert(uint64_t frame_id) override;
+    void record_access(uint64_t frame_id) override;
+    void remove(uint64_t frame_id) override;
+    uint64_t pick_victim(
+            const std::function<bool(uint64_t)>& is_evictable) override;
+    std::vector<uint64_t> get_fifo_list() const override;
+    std::vector<uint64_t> get_lru_list() const override;
+
+    static constexpr uint8_t MAX_USAGE_COUNT = 5;
+
+private:
+    struct Entry {
+        bool tracked = false;
+        uint8_t usage_count = 0;
+    };
+
+    std::vector<Entry> entries_;
+    size_t tracked_count_ = 0;
+    size_t hand_ = 0;
+};
+
+}  // namespace buzzdb
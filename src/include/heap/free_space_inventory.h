@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "buffer/buffer_manager.h"
+
+namespace buzzdb {
+
+/// The free-space inventory (FSI) of a heap segment. It keeps a 4-bit
+/// fullness class per page in pages of a segment of its own, so that one
+/// FSI page covers the free space of tens of thousands of heap pages.
+///
+/// A class is the free space of a page, in fifteenths of the free space of
+/// an empty page, rounded down. So a page of a class that suffices for a
+/// record surely has room for it, while the last bytes of a page are only
+/// found by checking the page itself.
+///
+/// Above the classes, the FSI keeps the highest class of every group of
+/// `GROUP_PAGES` pages in memory, so searches skip groups of full pages
+/// without reading their entries.
+class FreeSpaceInventory {
+
+public:
+	/// Set in the id of the segment that holds the FSI of a segment.
+	static constexpr uint16_t SEGMENT_ID_BIT = 0x4000;
+	/// The class of an empty page
+	static constexpr uint8_t MAX_CLASS = 15;
+	/// Number of heap pages that share an entry of the summary
+	static constexpr uint64_t GROUP_PAGES = 64;
+
+	/// Returns the id of the segment that holds the FSI of a segment.
+	static uint16_t get_segment_id(uint16_t heap_segment_id) {
+		return heap_segment_id | SEGMENT_ID_BIT;
+	}
+
+	/// Constructor.
+	/// @param[in] heap_segment_id  Id of the segment.
+	/// @param[in] max_free_space   Free space of an empty page.
+	/// @param[in] buffer_manager   The buffer manager of the segment.
+	FreeSpaceInventory(uint16_t heap_segment_id, uint32_t max_free_space,
+			BufferManager &buffer_manager);
+
+	/// Returns the class of a page with the given free space.
+	uint8_t get_class(uint32_t free_space) const;
+
+	/// Returns the lowest class whose pages surely have room for `size`
+	/// bytes. Returns a class above MAX_CLASS if no page has.
+	uint32_t get_min_class(uint32_t size) const;
+
+	/// Records the free space of a page that was appended to the segment.
+	/// @param[in] segment_page_id  The page in the heap segment.
+	/// @param[in] free_space       The free space of the page.
+	void add_page(uint64_t segment_page_id, uint32_t free_space);
+
+	/// Records the free space of a page.
+	/// @param[in] segment_page_id  The page in the heap segment.
+	/// @param[in] free_space       The free space of the page.
+	void update(uint64_t segment_page_id, uint32_t free_space);
+
+	/// Finds the first of the pages [0, page_count) that surely has room for
+	/// `size` bytes. Returns false if there is none.
+	bool find(uint32_t size, uint64_t page_count, uint64_t &segment_page_id);
+
+private:
+	/// Returns the number of heap pages that an FSI page covers.
+	uint64_t get_entries_per_page() const;
+
+	/// Returns the id of the FSI page that covers a heap page.
+	uint64_t get_fsi_page_id(uint64_t segment_page_id) const;
+
+	/// Returns the group of a heap page. Groups do not span FSI pages.
+	uint64_t get_group(uint64_t segment_page_id) const;
+
+	/// Returns the first heap page of the group of a heap page.
+	uint64_t get_group_begin(uint64_t segment_page_id) const;
+
+	/// Returns the heap page after the group of a heap page.
+	uint64_t get_group_end(uint64_t segment_page_id) const;
+
+	/// Returns the class of a heap page from the entries of its FSI page.
+	uint8_t get_entry(const uint8_t* entries, uint64_t segment_page_id) const;
+
+	/// The id of the heap segment
+	uint16_t heap_segment_id_;
+
+	/// Free space of an empty page
+	uint32_t max_free_space_;
+
+	/// The buffer manager
+	BufferManager &buffer_manager_;
+
+	/// All pages before it are of class 0, so searches start here
+	uint64_t first_candidate_ = 0;
+
+	/// The highest class of the pages of every group. Exact, as every entry
+	/// is written by `update()` after `add_page()` cleared its FSI page.
+	std::vector<uint8_t> group_classes_;
+};
+
+}  // namespace buzzdb
@@ -4,9 +4,13 @@
 #include <vector>
 #include <atomic>
 #include <cstddef>
+#include <memory>
 
 #include "buffer/buffer_manager.h"
+#include "heap/free_space_inventory.h"
+#include "heap/zone_map.h"
 #include "log/log_manager.h"
+#include "storage/schema.h"
 #include "storage/slotted_page.h"  // for TID
 #include "common/macros.h"
 
@@ -78,17 +82,50 @@ public:
 
 	/// Allocate a new record.
 	/// Returns a TID that stores the page as well as the slot of the allocated
-	/// record. The allocate method should use the free-space inventory to find a
-	/// suitable page quickly.
+	/// record. The free-space inventory finds a suitable page, so that
+	/// allocating usually fixes a single heap page.
 	/// @param[in] size         The size that should be allocated.
 	TID allocate(uint32_t record_size);
 
+	/// Append records to new pages at the end of the segment. The pages are
+	/// built in memory and written to the segment file with large sequential
+	/// writes, bypassing the buffer and the log. Instead, the file is synced
+	/// before the call returns. The records get consecutive slots of
+	/// consecutive pages, starting at page page_count_. Throws
+	/// `std::length_error` if a record does not fit into a page.
+	/// @param[in] records      The records, one after the other.
+	/// @param[in] record_size  The size of each record.
+	/// @param[in] record_count The number of records.
+	void bulk_append(const std::byte *records, uint32_t record_size,
+			uint64_t record_count);
+
+	/// Number of pages that bulk_append writes at once
+	static constexpr uint64_t BULK_PAGES = 64;
+
 	/// Read the data of the record into a buffer.
 	/// @param[in] tid          The TID that identifies the record.
 	/// @param[in] record       The buffer that is read into.
 	/// @param[in] capacity     The capacity of the buffer that is read into.
 	uint32_t read(TID tid, std::byte *record, uint32_t capacity) const;
 
+	/// Returns a view of a record on a page that the caller has already fixed,
+	/// without fixing the page again or copying the record.
+	/// @param[in] frame        The frame of the page of the record.
+	/// @param[in] tid          The TID that identifies the record.
+	TupleView read_view(BufferFrame &frame, TID tid) const;
+
+	/// Read a fixed-width field of the records of a page into a dense column,
+	/// in the order of the slots. The records must have the layout of the
+	/// schema. Instantiated for INT32 and INT64.
+	/// @param[in] segment_page_id  The page in the segment.
+	/// @param[in] schema       The schema of the records.
+	/// @param[in] column       The column, which must have the type T.
+	/// @param[out] values      Receives the values.
+	template <ColumnType T>
+	void read_column(uint64_t segment_page_id, const Schema &schema,
+			uint16_t column,
+			std::vector<typename ColumnTraits<T>::value_type> &values) const;
+
 	/// Write a record.
 	/// @param[in] tid          The TID that identifies the record.
 	/// @param[in] record       The buffer that is written.
@@ -96,6 +133,24 @@ public:
 	/// @param[in] txn_id		The txn_id for the transaction
 	uint32_t write(TID tid, std::byte* record, uint32_t record_size, uint64_t txn_id = INVALID_TXN_ID);
 
+	/// Erase a record. Its slot is reused by later allocations, and its space
+	/// once the page is compactified.
+	/// @param[in] tid          The TID that identifies the record.
+	void erase(TID tid);
+
+	/// Resize a record, keeping its leading bytes. A record that outgrows its
+	/// page moves to another page, and its TID redirects there.
+	/// @param[in] tid          The TID that identifies the record.
+	/// @param[in] record_size  The new size of the record.
+	void resize(TID tid, uint32_t record_size);
+
+	/// Keep zone maps of the first int fields of the records, which must
+	/// consist of int fields. All writers of the segment must enable them,
+	/// before the first record is allocated. Scans of the segment only
+	/// consult the zone map if it is enabled.
+	/// @param[in] field_count  Number of int fields of the records.
+	void enable_zone_map(uint16_t field_count);
+
 	/// The segment id
 	uint16_t segment_id_;
 
@@ -107,6 +162,33 @@ public:
 
 	/// Number of pages in segment
 	uint64_t page_count_;
+
+	/// The free-space inventory
+	FreeSpaceInventory fsi_;
+
+	/// The zone map, if enabled
+	std::unique_ptr<ZoneMap> zone_map_;
+
+	/// Number of int fields of the records, if the zone map is enabled
+	uint16_t zone_map_field_count_ = 0;
+
+private:
+	/// Drops the zone map of a previous incarnation of the segment, which
+	/// no longer summarizes its pages. Called before the first page is
+	/// created, whether this segment keeps a zone map or not.
+	void truncate_zone_map();
+
+	/// Allocates the record on the page, if it has room. Keeps the
+	/// free-space inventory up to date either way.
+	bool try_allocate(uint64_t segment_page_id, uint32_t record_size, TID &tid);
+
+	/// Fixes the page that holds a record. Follows the redirect of a record
+	/// that was moved, and sets the TID to the one on the fixed page.
+	BufferFrame &fix_record(TID &tid, bool exclusive) const;
+
+	/// Erases the slot of a TID and keeps the free-space inventory and the
+	/// zone map up to date. Returns what the slot held.
+	SlottedPage::Slot erase_slot(TID tid);
 };
 
 std::ostream &operator<<(std::ostream &os, HeapSegment const &s);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "buffer/buffer_manager.h"
+#include "heap/zone_map.h"
+#include "storage/pax_page.h"
+
+namespace buzzdb {
+
+/// A segment of PAX pages, for tables whose tuples consist of fixed-width
+/// int fields. Tuples are appended to the last page of the segment. Scans
+/// read the pages through `SeqScan` just like slotted pages.
+class PaxSegment {
+
+public:
+	/// Constructor.
+	/// @param[in] segment_id       Id of the segment.
+	/// @param[in] field_count      Number of int fields of a tuple.
+	/// @param[in] buffer_manager   The buffer manager that should be used by the
+	/// segment.
+	PaxSegment(uint16_t segment_id, uint16_t field_count,
+			BufferManager &buffer_manager);
+
+	/// Appends a tuple to the last page, or to a new page when it is full.
+	/// @param[in] fields       The `field_count_` fields of the tuple.
+	TID append(const int *fields);
+
+	/// Read the fields of a tuple.
+	/// @param[in] tid          The TID that identifies the tuple.
+	/// @param[out] fields      Receives the `field_count_` fields.
+	void read(TID tid, int *fields) const;
+
+	/// Keep zone maps of the fields. All writers of the segment must enable
+	/// them, before the first tuple is appended.
+	void enable_zone_map();
+
+	/// The segment id
+	uint16_t segment_id_;
+
+	/// Number of int fields of a tuple
+	uint16_t field_count_;
+
+	/// The buffer manager
+	BufferManager &buffer_manager_;
+
+	/// Number of pages in segment
+	uint64_t page_count_;
+
+	/// The zone map, if enabled
+	std::unique_ptr<ZoneMap> zone_map_;
+
+private:
+	/// Drops a zone map that an earlier segment with this id left behind.
+	/// Called before the first page is appended, also when zone maps are
+	/// not enabled, as scans could otherwise skip pages by stale entries.
+	void truncate_zone_map();
+};
+
+}  // namespace buzzdb
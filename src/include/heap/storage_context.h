@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+
+#include "buffer/buffer_manager.h"
+#include "log/log_manager.h"
+#include "storage/file.h"
+
+namespace buzzdb {
+
+/// The buffer pool and the log that all heap segments of the process share.
+/// Operators that are not handed a `HeapSegment` build theirs on the
+/// default context, so that repeated scans find their pages in memory.
+class StorageContext {
+
+public:
+	/// Constructor. Opens the log file at `LOG_FILE_PATH`.
+	/// @param[in] page_size  Size in bytes of the pages of the pool.
+	/// @param[in] page_count Number of frames of the pool.
+	StorageContext(size_t page_size, size_t page_count);
+
+	StorageContext(const StorageContext&) = delete;
+	StorageContext& operator=(const StorageContext&) = delete;
+
+	/// Returns the context of the process with `BUFFER_PAGE_SIZE` and
+	/// `BUFFER_PAGE_COUNT`, creating it on first use.
+	/// Is thread-safe.
+	static StorageContext& get_default();
+
+	BufferManager& get_buffer_manager() { return buffer_manager_; }
+
+	LogManager& get_log_manager() { return *log_manager_; }
+
+private:
+	std::unique_ptr<File> log_file_;
+
+	std::unique_ptr<LogManager> log_manager_;
+
+	BufferManager buffer_manager_;
+};
+
+}  // namespace buzzdb
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "buffer/buffer_manager.h"
+
+namespace buzzdb {
+
+/// The summary of one or more pages of a heap segment.
+struct PageSummary {
+	/// Number of tuples
+	uint64_t tuple_count;
+	/// Lower bounds of the summarized int fields of the tuples
+	std::vector<int> min;
+	/// Upper bounds of the summarized int fields of the tuples
+	std::vector<int> max;
+};
+
+/// Per-page min/max summaries (zone maps) of the leading int fields of the
+/// tuples of a heap segment. They are kept in a segment of their own, so
+/// that a scan can decide whether to skip a page without fixing it.
+///
+/// The bounds only ever widen: overwriting a value keeps the old one inside
+/// them. They are only reliable if every writer of the heap segment keeps
+/// them up to date.
+class ZoneMap {
+
+public:
+	/// Set in the id of the segment that holds the zone map of a segment.
+	static constexpr uint16_t SEGMENT_ID_BIT = 0x8000;
+	/// Maximum number of summarized fields
+	static constexpr uint16_t MAX_FIELDS = 8;
+	/// Identifies formatted zone map pages
+	static constexpr uint64_t MAGIC = 0x5a4f4e454d415021ull;
+
+	/// Returns the id of the segment that holds the zone map of a segment.
+	static uint16_t get_segment_id(uint16_t heap_segment_id) {
+		return heap_segment_id | SEGMENT_ID_BIT;
+	}
+
+	/// Constructor.
+	/// @param[in] heap_segment_id  Id of the summarized segment.
+	/// @param[in] buffer_manager   The buffer manager of the segment.
+	ZoneMap(uint16_t heap_segment_id, BufferManager &buffer_manager);
+
+	/// Empties the summary of a newly allocated page. Also drops the
+	/// summaries of the following pages, which are allocated after it.
+	/// @param[in] segment_page_id  The page in the heap segment.
+	/// @param[in] field_count      Number of int fields of the tuples.
+	void reset_page(uint64_t segment_page_id, uint16_t field_count);
+
+	/// Counts a new tuple of a page.
+	/// @param[in] segment_page_id  The page in the heap segment.
+	/// @param[in] field_count      Number of int fields of the tuples.
+	void add_tuple(uint64_t segment_page_id, uint16_t field_count);
+
+	/// Replaces the summary of a page, e.g. of a page that was built at once.
+	/// @param[in] segment_page_id  The page in the heap segment.
+	/// @param[in] field_count      Number of int fields of the tuples.
+	/// @param[in] summary          The summary of the tuples of the page.
+	void set_summary(uint64_t segment_page_id, uint16_t field_count,
+			const PageSummary &summary);
+
+	/// Stops counting an erased tuple of a page. The bounds stay as wide as
+	/// they are, which is still correct.
+	/// @param[in] segment_page_id  The page in the heap segment.
+	/// @param[in] field_count      Number of int fields of the tuples.
+	void remove_tuple(uint64_t segment_page_id, uint16_t field_count);
+
+	/// Widens the bounds of a page to include the fields of a tuple.
+	/// @param[in] segment_page_id  The page in the heap segment.
+	/// @param[in] fields           The int fields of the tuple.
+	/// @param[in] field_count      Number of int fields of the tuples.
+	void add_values(uint64_t segment_page_id, const int *fields,
+			uint16_t field_count);
+
+	/// Drops the summaries of the pages from `page_count` on, e.g. when the
+	/// heap segment is created anew. Scans read these pages until they are
+	/// summarized again.
+	/// @param[in] page_count       Number of pages that keep their summary.
+	void truncate(uint64_t page_count);
+
+	/// Gets the summary of a page. Returns false if the page has none.
+	bool get_summary(uint64_t segment_page_id, PageSummary &summary);
+
+	/// Gets the combined summary of the pages [0, page_count). Returns false
+	/// if one of them has none.
+	bool get_table_summary(uint64_t page_count, PageSummary &summary);
+
+private:
+	/// Header of a page of the zone map. It is followed by the entries of
+	/// consecutive pages of the heap segment.
+	struct Header {
+		/// overall page id, which tells stale frames apart
+		uint64_t overall_page_id;
+		/// Always MAGIC
+		uint64_t magic;
+		/// Number of summarized fields
+		uint32_t field_count;
+		/// Number of entries in use
+		uint32_t entry_count;
+	};
+
+	struct Entry {
+		uint32_t tuple_count;
+		int32_t min[MAX_FIELDS];
+		int32_t max[MAX_FIELDS];
+	};
+
+	/// Returns the number of entries of a zone map page.
+	uint64_t get_entries_per_page() const;
+
+	/// Returns the page of the zone map that holds the entry of a heap page.
+	uint64_t get_zone_page_id(uint64_t segment_page_id) const;
+
+	/// Returns the entry of a heap page in its fixed zone map page, or
+	/// nullptr if it has none.
+	Entry *find_entry(BufferFrame &frame, uint64_t segment_page_id) const;
+
+	/// Fixes the zone map page of a heap page exclusively and returns the
+	/// entry of the heap page, formatting the page and the entry if needed,
+	/// or if `reset` is set.
+	Entry *fix_entry(uint64_t segment_page_id, uint16_t field_count,
+			bool reset, BufferFrame *&frame);
+
+	/// The id of the summarized segment
+	uint16_t heap_segment_id_;
+
+	/// The buffer manager
+	BufferManager &buffer_manager_;
+};
+
+}  // namespace buzzdb
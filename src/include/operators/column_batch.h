@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace buzzdb {
+namespace operators {
+
+/// A chunk of up to `capacity()` tuples of integer fields, stored column by
+/// column. The columns are allocated once and reused for every batch, and
+/// their values are contiguous, so that operators can process them in tight
+/// (vectorizable) loops.
+class ColumnBatch {
+ public:
+  static constexpr size_t DEFAULT_CAPACITY = 1024;
+
+  /// Constructor.
+  /// @param[in] num_fields Number of columns.
+  /// @param[in] capacity   Maximum number of tuples of a batch.
+  explicit ColumnBatch(size_t num_fields, size_t capacity = DEFAULT_CAPACITY)
+      : num_fields_(num_fields),
+        capacity_(capacity),
+        values_(num_fields * capacity) {}
+
+  /// Returns the number of tuples in the batch.
+  size_t size() const { return size_; }
+
+  /// Returns the maximum number of tuples in the batch.
+  size_t capacity() const { return capacity_; }
+
+  /// Returns the number of columns.
+  size_t num_fields() const { return num_fields_; }
+
+  /// Returns the values of a column. Holds `size()` valid values.
+  int* column(size_t field) { return values_.data() + field * capacity_; }
+
+  const int* column(size_t field) const {
+    return values_.data() + field * capacity_;
+  }
+
+  /// Sets the number of valid tuples, after the columns were filled.
+  void set_size(size_t size) { size_ = size; }
+
+  /// Removes all tuples. Keeps the memory of the columns.
+  void clear() { size_ = 0; }
+
+ private:
+  size_t num_fields_;
+  size_t capacity_;
+  size_t size_ = 0;
+  std::vector<int> values_;
+};
+
+}  // namespace operators
+}  // namespace buzzdb
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace buzzdb {
+namespace operators {
+
+enum class PredicateType {
+    EQ,  // a == b
+    NE,  // a != b
+    LT,  // a < b
+    LE,  // a <= b
+    GT,  // a > b
+    GE   // a >= b
+  };
+
+/// A `field op constant` predicate over an int field.
+struct Predicate {
+  size_t field;
+  PredicateType op;
+  int constant;
+};
+
+/// Returns true if `value op constant` holds.
+inline bool evaluate(PredicateType op, int value, int constant) {
+  switch (op) {
+    case PredicateType::EQ: return value == constant;
+    case PredicateType::NE: return value != constant;
+    case PredicateType::LT: return value < constant;
+    case PredicateType::LE: return value <= constant;
+    case PredicateType::GT: return value > constant;
+    case PredicateType::GE: return value >= constant;
+  }
+  return false;
+}
+
+/// Returns true if some value in [min, max] may satisfy `value op constant`.
+inline bool may_satisfy(PredicateType op, int min, int max, int constant) {
+  switch (op) {
+    case PredicateType::EQ: return min <= constant && constant <= max;
+    case PredicateType::NE: return min != constant || max != constant;
+    case PredicateType::LT: return min < constant;
+    case PredicateType::LE: return min <= constant;
+    case PredicateType::GT: return max > constant;
+    case PredicateType::GE: return max >= constant;
+  }
+  return true;
+}
+
+/// Implementations of the filter kernel.
+enum class FilterKernel { SCALAR, AVX2, AVX512 };
+
+/// Returns true if the CPU can run the kernel.
+bool is_supported(FilterKernel kernel);
+
+/// Returns the fastest kernel that the CPU can run.
+FilterKernel get_best_kernel();
+
+/// Writes the positions of the values that satisfy `value op constant` to
+/// the selection vector, in ascending order, and returns their number. The
+/// selection vector must have room for `count` positions.
+/// @param[in] values       The values of a column.
+/// @param[in] count        Number of values.
+/// @param[out] selection   The selection vector.
+size_t select(const int* values, size_t count, PredicateType op, int constant,
+              uint32_t* selection);
+
+/// Like `select`, but with the given kernel, which must be supported.
+size_t select(FilterKernel kernel, const int* values, size_t count,
+              PredicateType op, int constant, uint32_t* selection);
+
+}  // namespace operators
+}  // namespace buzzdb
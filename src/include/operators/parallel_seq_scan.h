@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "buffer/buffer_manager.h"
+#include "heap/heap_file.h"
+#include "operators/column_batch.h"
+#include "operators/filter.h"
+
+namespace buzzdb {
+namespace operators {
+
+/// A range of pages [first_page, end_page) of a segment.
+struct Morsel {
+  uint64_t first_page;
+  uint64_t end_page;
+};
+
+/// Hands the morsels of a scan to worker threads. Every worker starts with a
+/// contiguous share of the morsels and takes them from the front of its own
+/// queue. A worker whose queue is empty steals from the back of the queue of
+/// another worker, which is the part the owner would reach last.
+class MorselScheduler {
+ public:
+  /// Returns the queue of a morsel.
+  using QueueFunction = std::function<size_t(const Morsel&)>;
+
+  /// Constructor.
+  /// @param[in] num_pages    Number of pages of the scan.
+  /// @param[in] morsel_pages Number of pages of a morsel.
+  /// @param[in] worker_count Number of workers.
+  MorselScheduler(uint64_t num_pages, uint64_t morsel_pages,
+                  size_t worker_count);
+
+  /// Constructor for queues that are shared by several workers, e.g. one
+  /// per partition of the buffer pool. The workers pass the id of their
+  /// queue to `next()`.
+  /// @param[in] num_pages    Number of pages of the scan.
+  /// @param[in] morsel_pages Number of pages of a morsel.
+  /// @param[in] queue_count  Number of queues.
+  /// @param[in] get_queue    Returns the queue of a morsel.
+  MorselScheduler(uint64_t num_pages, uint64_t morsel_pages,
+                  size_t queue_count, const QueueFunction& get_queue);
+
+  /// Gets the next morsel of the worker, or of the queue it uses. Returns
+  /// false when all morsels are taken.
+  bool next(size_t worker_id, Morsel& morsel);
+
+ private:
+  struct alignas(64) Queue {
+    std::mutex mutex;
+    std::deque<Morsel> morsels;
+  };
+
+  std::unique_ptr<Queue[]> queues_;
+  size_t worker_count_;
+};
+
+/// Scans the pages of a heap segment with several threads. The pages are
+/// split into morsels, and every worker scans the morsels it gets from a
+/// `MorselScheduler` into batches of its own. When the buffer pool has
+/// several partitions, the morsels are queued by the partition of their
+/// pages, and a worker first takes the morsels of the partition that is
+/// local to its NUMA node.
+class ParallelSeqScan {
+ public:
+  /// Pages of a morsel. A morsel never spans two partitions of the buffer
+  /// pool.
+  static constexpr uint64_t MORSEL_PAGES = BufferManager::PARTITION_EXTENT_PAGES;
+
+  /// Called for every batch with the id of the worker that produced it.
+  using Consumer = std::function<void(size_t, const ColumnBatch&)>;
+
+  /// Scans the table through the default `StorageContext`.
+  /// @param[in] thread_count Number of workers, 0 uses one per core.
+  ParallelSeqScan(uint16_t table_id, uint64_t num_pages, uint64_t num_fields,
+                  size_t thread_count = 0);
+
+  /// Scans the heap segment, using the buffer pool of the segment.
+  ParallelSeqScan(HeapSegment& heap_segment, uint64_t num_pages,
+                  uint64_t num_fields, size_t thread_count = 0);
+
+  /// Returns the scanned heap segment.
+  HeapSegment& get_heap_segment() { return *_heap_segment; }
+
+  /// Returns the number of workers. Never more than there are morsels.
+  size_t get_thread_count() const { return _thread_count; }
+
+  /// Only returns tuples that satisfy all of the predicates.
+  void set_predicates(std::vector<Predicate> predicates) {
+    _predicates = std::move(predicates);
+  }
+
+  /// Scans all pages. The consumer is called concurrently by the workers,
+  /// a batch is only valid during the call. Rethrows the first exception of
+  /// a worker after all workers stopped.
+  void run(const Consumer& consumer);
+
+ private:
+  /// Uses up to `thread_count` workers, 0 meaning one per core.
+  void set_thread_count(size_t thread_count);
+
+  /// Scans morsels until the scheduler runs out of them.
+  void run_worker(size_t worker_id, MorselScheduler& scheduler,
+                  const Consumer& consumer);
+
+  /// Segment that is created by the scan, if it was not handed one
+  std::unique_ptr<HeapSegment> _own_heap_segment;
+  HeapSegment* _heap_segment;
+  uint64_t _num_pages, _num_fields;
+  size_t _thread_count;
+  std::vector<Predicate> _predicates;
+};
+
+}  // namespace operators
+}  // namespace buzzdb
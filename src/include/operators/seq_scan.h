@@ -2,41 +2,88 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <vector>
 #include <tuple>
 #include "common/macros.h"
 #include "heap/heap_file.h"
+#include "heap/zone_map.h"
 #include "log/log_manager.h"
 #include "transaction/transaction_manager.h"
 #include "common/macros.h"
 #include "buffer/buffer_manager.h"
+#include "operators/column_batch.h"
+#include "operators/filter.h"
+#include "storage/pax_page.h"
 
 namespace buzzdb {
 namespace operators {
 
-enum class PredicateType {
-    EQ,  // a == b
-    NE,  // a != b
-    LT,  // a < b
-    LE,  // a <= b
-    GT,  // a > b
-    GE   // a >= b
-  };
-
-
 class SeqScan {
  private:
     uint16_t _table_id;
     std::vector<int> _tuple;
+    /// Segment that is created by the scan, if it was not handed one
+    std::unique_ptr<HeapSegment> _own_heap_segment;
     HeapSegment* _heap_segment;
     BufferManager* _buffer_manager;
+    /// Keeps the scan from evicting the working set of the buffer pool
+    BufferRing _ring;
     uint64_t _curr_segment, _num_pages, _curr_slot, _num_fields;
+    /// First page of the scanned range, `_num_pages` is its end
+    uint64_t _first_page = 0;
+    /// The current page, which stays fixed while the scan reads its records
+    BufferFrame* _frame = nullptr;
+    /// Conjunction of predicates that the tuples must satisfy
+    std::vector<Predicate> _predicates;
+    /// Zone map of the segment, which is consulted when there are predicates
+    /// and the segment keeps one
+    ZoneMap* _zone_map = nullptr;
+    PageSummary _summary;
+    /// Batch scratch space: the records of the current page, the values of
+    /// the field that is filtered, and selection vectors of the records
+    std::vector<const std::byte*> _records;
+    std::vector<int> _values;
+    std::vector<uint32_t> _selection, _matches;
+
+    /// Prefetches the next pages when the scan enters a read-ahead window.
+    void prefetch_next_pages();
+    /// Fixes the current page, unless it is already fixed. Skips pages that
+    /// have no tuples satisfying the predicates according to the zone map.
+    /// Returns false if no page is left.
+    bool fix_current_page();
+    /// Returns false if the zone map rules out that the page has tuples
+    /// satisfying the predicates.
+    bool may_match(uint64_t segment_page_id);
+    /// Unfixes the current page.
+    void release_page();
+    /// Returns true if the tuple satisfies all predicates.
+    bool matches(const TupleView& tuple) const;
+    bool matches(const PaxPage& page, uint16_t row) const;
+    /// Narrows `_selection` to the `count` values that satisfy the
+    /// predicate. `first` tells whether the values belong to all candidates,
+    /// instead of to the ones in `_selection`. Returns the selected number.
+    size_t apply_predicate(const Predicate& predicate, const int* values,
+        size_t count, bool first);
+    /// Filters the first `count` records of `_records`, leaving the
+    /// positions of the qualifying ones in `_selection`. Returns their number.
+    size_t filter_records(size_t count);
+    /// Like `filter_records`, for `count` rows of a PAX page.
+    size_t filter_pax_rows(const PaxPage& page, size_t first_row, size_t count);
+    /// Read the next tuples of the current page into the batch, starting
+    /// at row `rows` of the batch. Return the number of tuples read.
+    size_t read_slotted_page(ColumnBatch& batch, size_t rows, bool& page_done);
+    size_t read_pax_page(ColumnBatch& batch, size_t rows, bool& page_done);
 
  public:
+  /// Scans the table through the default `StorageContext`.
   SeqScan(uint16_t table_id, uint64_t num_pages, uint64_t num_fields);
 
+  /// Scans the heap segment, using the buffer pool of the segment.
+  SeqScan(HeapSegment& heap_segment, uint64_t num_pages, uint64_t num_fields);
+
   ~SeqScan();
 
   /// Initializes the operator.
@@ -49,6 +96,15 @@ class SeqScan {
   // resets the next pointer to the start of the table
   void reset();
 
+  /// Restricts the scan to the pages [first_page, end_page) of the segment
+  /// and resets it to the first of them.
+  void set_page_range(uint64_t first_page, uint64_t end_page);
+
+  /// Only returns tuples that satisfy all of the predicates. Pages are
+  /// skipped without being fixed, if the zone map of the segment rules them
+  /// out. Resets the scan.
+  void set_predicates(std::vector<Predicate> predicates);
+
   /// Destroys the operator.
   void close();
 
@@ -56,6 +112,13 @@ class SeqScan {
   /// `has_next()` returns true, the vector will contain the values for the
   /// next tuple. 
   std::vector<int> get_tuple();
+
+  /// Fills the batch with the next tuples of the table, copying the fields
+  /// straight from the pages into the columns. Reads slotted as well as PAX
+  /// pages. The predicates are evaluated
+  /// for a page at a time with the filter kernels, so only the fields of
+  /// qualifying tuples are copied. Returns false when the scan is exhausted.
+  bool next_batch(ColumnBatch& batch);
 };
 
 }  // namespace operators
@@ -1,6 +1,8 @@
 #pragma once
 #include <cstddef>
 #include <cstdint>
+#include "heap/zone_map.h"
+#include "operators/parallel_seq_scan.h"
 #include "operators/seq_scan.h"
 #include <vector>
 
@@ -17,6 +19,7 @@ class IntHistogram {
         
         double estimate_selectivity(PredicateType op, int64_t v);
         void add_value(int64_t val);
+        void merge(const IntHistogram& other);
 
         double span;
         int64_t min_v;
@@ -33,11 +36,19 @@ class TableStats{
         TableStats() = default;
         TableStats(int64_t table_id, int64_t io_cost_per_page, 
                 uint64_t num_pages, uint64_t num_fields);
+        TableStats(HeapSegment& heap_segment, int64_t io_cost_per_page,
+                uint64_t num_pages, uint64_t num_fields);
         double estimate_selectivity(int64_t field, PredicateType op, int64_t constant);
         double estimate_scan_cost();
         uint64_t estimate_table_cardinality(double selectivity_factor);
         
     private:
+        /// Scans the table once for the value ranges and once for the
+        /// histograms, each with all workers of the scan. Takes the value
+        /// ranges from the zone map instead, if the table has one.
+        void build(buzzdb::operators::ParallelSeqScan& scan, int64_t io_cost_per_page,
+                uint64_t num_pages, uint64_t num_fields);
+
         /**
          * Number of bins for the histogram. Feel free to increase this value over
          * 100, though our tests assume that you have at least 100 bins in your
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 
@@ -13,11 +14,33 @@ class File {
   /// File mode (read or write)
   enum Mode { READ, WRITE };
 
+  /// How writes reach the device
+  enum class IOMode {
+    /// Every write is flushed to the device before it returns (O_SYNC).
+    SYNC,
+    /// Like `SYNC`, but metadata that is not needed to read the data back,
+    /// such as the modification time, is not flushed (O_DSYNC).
+    DSYNC,
+    /// Writes go to the OS page cache; `sync()` makes them durable.
+    BUFFERED,
+    /// Reads and writes bypass the OS page cache (O_DIRECT). Buffers,
+    /// offsets and sizes must be multiples of `DIRECT_IO_ALIGNMENT`.
+    /// `sync()` makes the writes durable.
+    DIRECT
+  };
+
+  /// Alignment that buffers, offsets and sizes need in `IOMode::DIRECT`
+  static constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+
   virtual ~File() = default;
 
   /// Returns the `Mode` this file was opened with.
   virtual Mode get_mode() const = 0;
 
+  /// Returns the `IOMode` the file uses. May differ from the requested mode
+  /// when the file system does not support direct I/O.
+  virtual IOMode get_io_mode() const { return IOMode::SYNC; }
+
   /// Returns the current size of the file in bytes.
   /// Is not thread-safe w.r.t concurrent calls to `resize()`.
   virtual size_t size() const = 0;
@@ -59,11 +82,102 @@ class File {
   /// @param[in] size   The size of the block.
   virtual void write_block(const char* block, size_t offset, size_t size) = 0;
 
+  /// Flushes all completed writes to the device, so that they survive a
+  /// crash. Does nothing for files that are opened with `IOMode::SYNC` or
+  /// `IOMode::DSYNC`.
+  /// Is thread-safe w.r.t concurrent calls to `read_block()` and
+  /// `write_block()`.
+  virtual void sync() {}
+
+  /// A block read or write that is executed asynchronously.
+  struct IORequest {
+    enum Type { READ, WRITE };
+
+    IORequest() = default;
+    IORequest(Type type, size_t offset, size_t size, char* block)
+        : type(type), offset(offset), size(size), block(block) {}
+
+    Type type = READ;
+    /// The offset in the file at which the block starts.
+    size_t offset = 0;
+    /// The size of the block.
+    size_t size = 0;
+    /// The memory that is read into or written from. Must stay valid until
+    /// the request completed.
+    char* block = nullptr;
+
+    /// Set by the file: number of bytes transferred so far
+    size_t transferred = 0;
+    /// Set by the file: errno of a failed request, 0 otherwise
+    int error = 0;
+    /// Set by the file: whether the request completed
+    bool done = false;
+  };
+
+  /// Starts the given requests and returns without waiting for them. The
+  /// requests must not be modified or destroyed before `complete()`
+  /// returned for them. Reads past the end of the file leave the rest of
+  /// the block untouched, like `read_block()`.
+  /// The default implementation executes the requests synchronously.
+  /// Is thread-safe w.r.t concurrent calls to `submit()`, `complete()`,
+  /// `read_block()` and `write_block()`.
+  virtual void submit(IORequest* requests, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      IORequest& request = requests[i];
+      if (request.type == IORequest::READ) {
+        read_block(request.offset, request.size, request.block);
+      } else {
+        write_block(request.block, request.offset, request.size);
+      }
+      request.transferred = request.size;
+      request.done = true;
+    }
+  }
+
+  /// Waits until all given requests, which were passed to `submit()`
+  /// before, completed. Throws `std::system_error` if one of them failed.
+  /// Is thread-safe w.r.t concurrent calls to `submit()` and `complete()`.
+  virtual void complete(IORequest* /*requests*/, size_t /*count*/) {}
+
+  /// Expected access pattern of a range of the file
+  enum class AccessAdvice { NORMAL, SEQUENTIAL, RANDOM, WILLNEED };
+
+  /// Maps the file read-only into memory and returns the start of the
+  /// mapping, which covers `size()` bytes. Returns nullptr when the file is
+  /// empty or cannot be mapped. Repeated calls return the same mapping; it
+  /// stays valid until the file is destroyed.
+  /// Is not thread-safe.
+  virtual const char* map_read_only() { return nullptr; }
+
+  /// Tells the operating system how a range of the file will be accessed.
+  /// Applies to the memory mapping when the file is mapped.
+  /// The default implementation ignores the advice.
+  virtual void advise(size_t /*offset*/, size_t /*size*/,
+                      AccessAdvice /*advice*/) {}
+
   /// Opens a file with the given mode. Existing files are never overwritten.
   /// @param[in] filename Path to the file.
   /// @param[in] mode     `Mode` that should be used to open the file.
   static std::unique_ptr<File> open_file(const char* filename, Mode mode);
 
+  /// Opens a file with the given mode and I/O mode. Falls back to
+  /// `IOMode::BUFFERED` when `IOMode::DIRECT` is not supported by the file
+  /// system.
+  /// @param[in] filename Path to the file.
+  /// @param[in] mode     `Mode` that should be used to open the file.
+  /// @param[in] io_mode  `IOMode` that should be used for reads and writes.
+  static std::unique_ptr<File> open_file(const char* filename, Mode mode,
+                                         IOMode io_mode);
+
+  /// Opens a file whose `submit()` and `complete()` keep many requests in
+  /// flight at once (io_uring). Falls back to `open_file()` when the kernel
+  /// does not support asynchronous I/O.
+  /// @param[in] filename Path to the file.
+  /// @param[in] mode     `Mode` that should be used to open the file.
+  /// @param[in] io_mode  `IOMode` that should be used for reads and writes.
+  static std::unique_ptr<File> open_async_file(
+      const char* filename, Mode mode, IOMode io_mode = IOMode::SYNC);
+
   /// Opens a temporary file in `WRITE` mode. The file will be deleted
   /// automatically after use.
   static std::unique_ptr<File> make_temporary_file();
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "storage/slotted_page.h"  // for TID
+
+namespace buzzdb {
+
+/// A page that stores tuples of fixed-width int fields column by column
+/// (PAX). The header is followed by one minipage per field, each with room
+/// for `capacity` values. Tuples need no slots, tuple i of the page consists
+/// of the i-th value of every minipage.
+struct PaxPage {
+  /// Identifies PAX pages. It overlays `SlottedPage::Header::buffer_frame`,
+  /// and since it is no canonical address, no slotted page can carry it.
+  static constexpr uint64_t MAGIC = 0x5041585041585041ull;
+  /// Alignment of the minipages, so that kernels can read them in full
+  /// cache lines.
+  static constexpr uint32_t MINIPAGE_ALIGNMENT = 64;
+
+  struct Header {
+    // Constructor
+    Header(uint32_t page_size, uint16_t field_count);
+
+    /// overall page id
+    uint64_t overall_page_id;
+    /// Always MAGIC
+    uint64_t magic;
+    /// Number of fields of a tuple
+    uint16_t field_count;
+    /// Number of tuples on the page
+    uint16_t tuple_count;
+    /// Number of tuples that fit on the page
+    uint16_t capacity;
+  };
+
+  /// Constructor.
+  /// @param[in] page_size    The size of the page.
+  /// @param[in] field_count  The number of int fields of a tuple.
+  PaxPage(uint32_t page_size, uint16_t field_count);
+
+  /// Returns the number of tuples with `field_count` fields that fit on a
+  /// page.
+  static uint16_t get_capacity(uint32_t page_size, uint16_t field_count);
+
+  /// Returns true if the page data holds a PAX page.
+  static bool is_pax_page(const char *data);
+
+  /// The header.
+  /// Like a slotted page, the PAX page resides on the buffer frame.
+  Header header;
+
+  /// Returns the minipage of a field.
+  int *get_column(uint16_t field);
+  const int *get_column(uint16_t field) const;
+
+  /// Returns true if no other tuple fits on the page.
+  bool is_full() const { return header.tuple_count == header.capacity; }
+
+  /// Appends a tuple. The page must not be full.
+  /// @param[in] fields       The `field_count` fields of the tuple.
+  TID add_tuple(const int *fields);
+};
+
+}  // namespace buzzdb
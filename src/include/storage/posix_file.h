@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "storage/file.h"
+
+namespace buzzdb {
+
+/// `File` implementation that uses blocking POSIX I/O calls.
+class PosixFile : public File {
+ private:
+  Mode mode;
+  IOMode io_mode = IOMode::SYNC;
+  int fd;
+  std::atomic<size_t> cached_size;
+  /// Read-only memory mapping of the file, if any
+  void* mapping = nullptr;
+  size_t mapping_size = 0;
+
+  size_t read_size();
+
+ protected:
+  /// Grows the cached size after a write that ended at `end`.
+  void extend_cached_size(size_t end);
+
+ public:
+  PosixFile(Mode mode, int fd, size_t size);
+
+  PosixFile(const char* filename, Mode mode, IOMode io_mode = IOMode::SYNC);
+
+  ~PosixFile() override;
+
+  Mode get_mode() const override { return mode; }
+
+  IOMode get_io_mode() const override { return io_mode; }
+
+  size_t size() const override { return cached_size; }
+
+  void resize(size_t new_size) override;
+
+  void read_block(size_t offset, size_t size, char* block) override;
+
+  void write_block(const char* block, size_t offset, size_t size) override;
+
+  void sync() override;
+
+  const char* map_read_only() override;
+
+  void advise(size_t offset, size_t size, AccessAdvice advice) override;
+
+  /// Returns the file descriptor of the file.
+  int get_fd() const { return fd; }
+};
+
+}  // namespace buzzdb
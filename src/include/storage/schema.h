@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace buzzdb {
+
+/// The type of the values of a column.
+enum class ColumnType : uint8_t { INT32, INT64, VARCHAR };
+
+/// The values of a column type, for accessors that are specialized at
+/// compile time.
+template <ColumnType T>
+struct ColumnTraits;
+
+template <>
+struct ColumnTraits<ColumnType::INT32> {
+  using value_type = int32_t;
+  /// Size of a field in the fixed-width prefix of a tuple
+  static constexpr uint32_t FIXED_SIZE = sizeof(int32_t);
+};
+
+template <>
+struct ColumnTraits<ColumnType::INT64> {
+  using value_type = int64_t;
+  static constexpr uint32_t FIXED_SIZE = sizeof(int64_t);
+};
+
+template <>
+struct ColumnTraits<ColumnType::VARCHAR> {
+  /// Points into the tuple, so it is only valid as long as the tuple is
+  using value_type = std::string_view;
+  /// Variable-length fields only take an entry of the offset array
+  static constexpr uint32_t FIXED_SIZE = 0;
+};
+
+/// Returns the size of a field of the type in the fixed-width prefix of a
+/// tuple, or 0 for variable-length types.
+uint32_t get_fixed_width(ColumnType type);
+
+/// A column of a table.
+struct Column {
+  /// The name of the column
+  std::string name;
+  /// The type of the values
+  ColumnType type;
+  /// Whether the column may hold NULL
+  bool nullable = false;
+};
+
+/// Describes the columns of a table and the layout of its tuples. A tuple
+/// consists of
+/// - the fixed-width fields, widest first, so that they need no padding,
+/// - the null bitmap with one bit per nullable column,
+/// - the offset array with the start of every variable-length field and
+///   the end of the last one, relative to the start of the tuple,
+/// - the variable-length data.
+/// Fields are stored unaligned, accessors copy them out.
+class Schema {
+ public:
+  /// Entry of `get_null_bit()` for columns that cannot be NULL
+  static constexpr uint16_t NOT_NULLABLE = UINT16_MAX;
+
+  /// Constructor.
+  /// @param[in] columns      The columns of the table.
+  explicit Schema(std::vector<Column> columns);
+
+  /// Returns the number of columns.
+  uint16_t get_column_count() const { return columns_.size(); }
+
+  /// Returns a column.
+  const Column &get_column(uint16_t column) const { return columns_[column]; }
+
+  /// Returns the offset of a fixed-width field in the tuple, or of the
+  /// start of a variable-length field in the offset array.
+  uint32_t get_offset(uint16_t column) const { return offsets_[column]; }
+
+  /// Returns the bit of a column in the null bitmap, or NOT_NULLABLE.
+  uint16_t get_null_bit(uint16_t column) const { return null_bits_[column]; }
+
+  /// Returns the offset of the null bitmap in the tuple.
+  uint32_t get_null_bitmap_offset() const { return null_bitmap_offset_; }
+
+  /// Returns the offset of the offset array in the tuple.
+  uint32_t get_offset_array_offset() const { return offset_array_offset_; }
+
+  /// Returns the variable-length columns in the order of their data.
+  const std::vector<uint16_t> &get_varlen_columns() const {
+    return varlen_columns_;
+  }
+
+  /// Returns the size of a tuple without its variable-length data. Tuples
+  /// of schemas without variable-length columns all have this size.
+  uint32_t get_fixed_size() const { return fixed_size_; }
+
+ private:
+  std::vector<Column> columns_;
+  std::vector<uint32_t> offsets_;
+  std::vector<uint16_t> null_bits_;
+  std::vector<uint16_t> varlen_columns_;
+  uint32_t null_bitmap_offset_;
+  uint32_t offset_array_offset_;
+  uint32_t fixed_size_;
+};
+
+}  // namespace buzzdb
@@ -27,7 +27,28 @@ struct TID {
 
 std::ostream &operator<<(std::ostream &os, TID const &t);
 
+/// A record inside a fixed page. The view points into the buffer frame, so it
+/// is only valid as long as the page stays fixed.
+struct TupleView {
+  /// The TID of the record
+  TID tid;
+  /// The data of the record
+  const std::byte *data;
+  /// The length of the record
+  uint32_t length;
+};
+
 struct SlottedPage {
+  /// Top byte of a slot that holds a record on the page. Slots with another
+  /// top byte hold the TID of a record that was moved to another page.
+  static constexpr uint8_t RECORD_TAG = 0xff;
+  /// Top byte of a slot that is linked into the free list.
+  /// The low bits hold the next free slot + 1, or 0 at the end of the list.
+  static constexpr uint8_t FREE_TAG = 0xfe;
+  static constexpr uint64_t FREE_LINK_MASK = 0xffff;
+  /// A record that was moved here from another page starts with its TID.
+  static constexpr uint32_t MOVED_PREFIX = sizeof(uint64_t);
+
   struct Header {
     // Constructor
     explicit Header(char *_buffer_frame, uint32_t page_size);
@@ -38,7 +59,7 @@ struct SlottedPage {
     char *buffer_frame;
     /// Number of currently used slots
     uint16_t slot_count;
-    /// To speed up the search for a free slot
+    /// Head of the list of freed slots, slot_count if the list is empty
     uint16_t first_free_slot;
     /// Lower end of the data
     uint32_t data_start;
@@ -52,6 +73,51 @@ struct SlottedPage {
     /// The slot value
     /// c.f. chapter 3 page 13
     uint64_t value;
+
+    /// Returns true if the slot is on the free list.
+    bool is_empty() const { return value >> 56 == FREE_TAG; }
+    /// Returns true if the slot holds the TID of a record on another page.
+    bool is_redirect() const {
+      return value >> 56 != RECORD_TAG && !is_empty();
+    }
+    /// Returns true if the slot holds a record on this page.
+    bool is_record() const { return value >> 56 == RECORD_TAG; }
+    /// Returns true if the record was moved here from another page.
+    bool is_moved() const { return (value << 8 >> 56) != 0; }
+    /// Returns the TID that a redirect points to.
+    TID get_redirect() const { return TID(value); }
+    /// Returns the offset of the record in the page.
+    uint32_t get_offset() const { return value << 16 >> 40; }
+    /// Returns the length of the record.
+    uint32_t get_length() const { return value << 40 >> 40; }
+  };
+
+  /// Walks the records of the page, skipping empty slots and redirects.
+  /// Records that were moved here are visited with their original TID.
+  class Iterator {
+   public:
+    /// Constructor.
+    /// @param[in] page         The page.
+    /// @param[in] slot_id      The first slot that is visited.
+    Iterator(SlottedPage *page, uint16_t slot_id);
+
+    TupleView operator*() const { return page_->get_tuple(slot_id_); }
+
+    Iterator &operator++();
+
+    bool operator==(const Iterator &other) const {
+      return slot_id_ == other.slot_id_;
+    }
+    bool operator!=(const Iterator &other) const { return !(*this == other); }
+
+    /// Returns the slot of the current record.
+    uint16_t get_slot_id() const { return slot_id_; }
+
+   private:
+    void skip_non_records();
+
+    SlottedPage *page_;
+    uint16_t slot_id_;
   };
 
   /// Constructor.
@@ -60,6 +126,8 @@ struct SlottedPage {
   explicit SlottedPage(char *buffer_frame, uint32_t page_size);
 
   /// Compact the page.
+  /// Moves the records to the end of the page, so that the free space is
+  /// contiguous again, and drops the free slots at the end of the slot array.
   /// @param[in] page_size    The size of a buffer frame.
   void compactify(uint32_t page_size);
 
@@ -72,12 +140,62 @@ struct SlottedPage {
   Header header;
 
   /// Slot array
-  // Slot* slots;
+  Slot *get_slots();
 
   Slot getSlot(uint16_t slotId);
 
+  /// Returns a view of the record in the slot without copying it.
+  /// @param[in] slot_id      The slot of the record.
+  TupleView get_tuple(uint16_t slot_id);
+
+  /// Iterators over the records of the page.
+  Iterator begin();
+  Iterator end();
+
+  /// Adds a slot for a record of the given size.
+  /// Freed slots are reused before the slot array grows.
   TID addSlot(uint32_t size);
 
+  /// Puts the slot on the free list so that the next addSlot reuses it.
+  /// The record space is reclaimed by compactify.
+  void freeSlot(uint16_t slotId);
+
+  /// Returns the space that adding a record of the given size takes,
+  /// including a new slot if no free slot can be reused.
+  uint32_t get_required_space(uint32_t size) const;
+
+  /// Returns the free space between the slot array and the records, which
+  /// addSlot can use without compactifying the page first.
+  uint32_t get_contiguous_space() const;
+
+  /// Erases the record or redirect in the slot and frees the slot.
+  /// @param[in] slot_id      The slot.
+  void erase(uint16_t slot_id);
+
+  /// Resizes the record in the slot, keeping its leading bytes. Compactifies
+  /// the page if the record only fits afterwards.
+  /// Returns false, without changing the record, if the page has no room.
+  /// @param[in] slot_id      The slot of the record.
+  /// @param[in] size         The new size of the record.
+  /// @param[in] page_size    The size of a buffer frame.
+  bool resize(uint16_t slot_id, uint32_t size, uint32_t page_size);
+
+  /// Releases the space of the record in the slot and lets the slot point to
+  /// the TID of the record on another page instead.
+  /// @param[in] slot_id      The slot of the record.
+  /// @param[in] target       The TID of the moved record.
+  void redirect(uint16_t slot_id, TID target);
+
+  /// Marks the record in the slot as moved here and stores its original TID
+  /// in front of it. The record must have been added with MOVED_PREFIX
+  /// additional bytes.
+  /// @param[in] slot_id      The slot of the record.
+  /// @param[in] original     The TID that redirects to the record.
+  void set_moved(uint16_t slot_id, TID original);
+
+  /// Returns the value of a slot that holds a record.
+  static uint64_t make_slot(uint32_t offset, uint32_t length, bool moved);
+
   void setSlot(uint16_t slotId, uint64_t value);
 };
 
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "storage/schema.h"
+
+namespace buzzdb {
+
+/// Reads the fields of a tuple with the layout of a schema. The accessors
+/// are specialized for the column type at compile time, so reading a field
+/// takes no branches on the type.
+class TupleReader {
+ public:
+  /// Constructor.
+  /// @param[in] schema       The schema of the tuple.
+  /// @param[in] data         The tuple, e.g. `TupleView::data`.
+  TupleReader(const Schema &schema, const std::byte *data)
+      : schema_(schema), data_(data) {}
+
+  /// Returns true if the field is NULL.
+  bool is_null(uint16_t column) const {
+    uint16_t bit = schema_.get_null_bit(column);
+    if (bit == Schema::NOT_NULLABLE) {
+      return false;
+    }
+    auto byte = static_cast<uint8_t>(
+        data_[schema_.get_null_bitmap_offset() + bit / 8]);
+    return (byte >> (bit % 8)) & 1;
+  }
+
+  /// Returns the value of a field, which must have the type T. NULL fields
+  /// read as 0 or the empty string.
+  template <ColumnType T>
+  typename ColumnTraits<T>::value_type get(uint16_t column) const {
+    assert(schema_.get_column(column).type == T);
+    return read<T>(data_, schema_.get_offset(column));
+  }
+
+  /// Reads a field at the offset that the schema gives for its column.
+  template <ColumnType T>
+  static typename ColumnTraits<T>::value_type read(const std::byte *data,
+                                                   uint32_t offset) {
+    if constexpr (T == ColumnType::VARCHAR) {
+      uint16_t bounds[2];
+      memcpy(bounds, data + offset, sizeof(bounds));
+      return std::string_view(reinterpret_cast<const char *>(data) + bounds[0],
+                              bounds[1] - bounds[0]);
+    } else {
+      typename ColumnTraits<T>::value_type value;
+      memcpy(&value, data + offset, sizeof(value));
+      return value;
+    }
+  }
+
+ private:
+  const Schema &schema_;
+  const std::byte *data_;
+};
+
+/// Copies a field of several tuples into a dense column, e.g. the records
+/// of a page that a scan collected. The field has the same offset in every
+/// tuple, so the loop neither branches on the type nor on the tuple.
+/// @param[in] schema       The schema of the tuples.
+/// @param[in] column       The column, which must have the type T.
+/// @param[in] tuples       The tuples.
+/// @param[in] count        The number of tuples.
+/// @param[out] values      Receives `count` values.
+template <ColumnType T>
+void gather_column(const Schema &schema, uint16_t column,
+                   const std::byte *const *tuples, size_t count,
+                   typename ColumnTraits<T>::value_type *values) {
+  assert(schema.get_column(column).type == T);
+  uint32_t offset = schema.get_offset(column);
+  for (size_t i = 0; i < count; i++) {
+    values[i] = TupleReader::read<T>(tuples[i], offset);
+  }
+}
+
+/// Builds tuples with the layout of a schema. Set the fields, then write
+/// the tuple into a record of `get_size()` bytes, e.g. one that
+/// `HeapSegment::allocate` returned.
+class TupleBuilder {
+ public:
+  /// Constructor.
+  /// @param[in] schema       The schema of the tuples.
+  explicit TupleBuilder(const Schema &schema);
+
+  /// Sets a field, which must have the type T. The value of a VARCHAR is
+  /// copied.
+  template <ColumnType T>
+  void set(uint16_t column, typename ColumnTraits<T>::value_type value) {
+    assert(schema_.get_column(column).type == T);
+    set_null_bit(column, false);
+    if constexpr (T == ColumnType::VARCHAR) {
+      varlen_[get_varlen_index(column)].assign(value);
+    } else {
+      memcpy(prefix_.data() + schema_.get_offset(column), &value,
+             sizeof(value));
+    }
+  }
+
+  /// Sets a field of a nullable column to NULL.
+  void set_null(uint16_t column);
+
+  /// Returns the size of the tuple. Throws `std::length_error` if the
+  /// variable-length data ends beyond what the 16-bit offsets can address.
+  uint32_t get_size() const;
+
+  /// Writes the tuple, whose size must have been checked by `get_size()`.
+  /// @param[out] tuple       Receives `get_size()` bytes.
+  void write(std::byte *tuple) const;
+
+  /// Returns the tuple.
+  std::vector<std::byte> build() const;
+
+  /// Resets all fields to 0, the empty string and not NULL.
+  void clear();
+
+ private:
+  /// Returns the position of a variable-length column in the offset array.
+  size_t get_varlen_index(uint16_t column) const {
+    return (schema_.get_offset(column) - schema_.get_offset_array_offset()) /
+           sizeof(uint16_t);
+  }
+
+  void set_null_bit(uint16_t column, bool null);
+
+  const Schema &schema_;
+  /// The tuple without its variable-length data
+  std::vector<std::byte> prefix_;
+  /// The values of the variable-length fields
+  std::vector<std::string> varlen_;
+};
+
+}  // namespace buzzdb
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "storage/posix_file.h"
+
+namespace buzzdb {
+
+/// `PosixFile` that executes `submit()`ed requests asynchronously through an
+/// io_uring instance, so that many block reads and writes can be in flight
+/// at the same time. `read_block()` and `write_block()` stay blocking.
+class UringFile : public PosixFile {
+ public:
+  /// Opens the file and sets up a ring with `queue_depth` entries.
+  /// Throws `std::system_error` when io_uring is not available.
+  UringFile(const char* filename, Mode mode, IOMode io_mode = IOMode::SYNC,
+            unsigned queue_depth = DEFAULT_QUEUE_DEPTH);
+
+  /// Waits for all requests in flight.
+  ~UringFile() override;
+
+  void submit(IORequest* requests, size_t count) override;
+
+  void complete(IORequest* requests, size_t count) override;
+
+  /// Returns whether the kernel supports io_uring with the read and write
+  /// opcodes.
+  static bool is_supported();
+
+  static constexpr unsigned DEFAULT_QUEUE_DEPTH = 64;
+
+ private:
+  /// Adds the (remaining part of the) request to the submission queue.
+  void push_request(IORequest& request);
+
+  /// Passes all queued requests to the kernel and, if `wait` is true, waits
+  /// until at least one request completed.
+  void enter(bool wait);
+
+  /// Processes all entries of the completion queue.
+  void reap_completions();
+
+  /// Unmaps the parts of the ring that are mapped and closes it.
+  void release_ring();
+
+  /// Serializes all accesses to the ring
+  std::mutex ring_mutex_;
+
+  int ring_fd_ = -1;
+
+  /// Number of requests the kernel has not completed yet
+  size_t in_flight_ = 0;
+  /// Number of requests pushed but not passed to the kernel yet
+  unsigned to_submit_ = 0;
+
+  unsigned sq_entries_ = 0;
+  unsigned cq_entries_ = 0;
+
+  void* sq_ring_ = nullptr;
+  size_t sq_ring_size_ = 0;
+  void* cq_ring_ = nullptr;
+  size_t cq_ring_size_ = 0;
+  void* sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_mask_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned* cq_mask_ = nullptr;
+  void* cqes_ = nullptr;
+};
+
+}  // namespace buzzdb
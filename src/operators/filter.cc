@@ -0,0 +1,194 @@
+#include "operators/filter.h"
+
+#include <type_traits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace buzzdb {
+namespace operators {
+
+namespace {
+
+template <PredicateType op>
+using OpTag = std::integral_constant<PredicateType, op>;
+
+/// Calls the function with the predicate type as a compile-time constant,
+/// so that every kernel is instantiated once per comparison.
+template <typename Function>
+size_t dispatch(PredicateType op, Function function) {
+  switch (op) {
+    case PredicateType::EQ: return function(OpTag<PredicateType::EQ>());
+    case PredicateType::NE: return function(OpTag<PredicateType::NE>());
+    case PredicateType::LT: return function(OpTag<PredicateType::LT>());
+    case PredicateType::LE: return function(OpTag<PredicateType::LE>());
+    case PredicateType::GT: return function(OpTag<PredicateType::GT>());
+    case PredicateType::GE: return function(OpTag<PredicateType::GE>());
+  }
+  return 0;
+}
+
+/// Writes every position and advances only past the selected ones, which
+/// avoids a branch per value.
+template <PredicateType op>
+size_t select_scalar(const int* values, size_t count, int constant,
+                     uint32_t base, uint32_t* selection) {
+  size_t selected = 0;
+  for (size_t i = 0; i < count; i++) {
+    selection[selected] = base + i;
+    selected += evaluate(op, values[i], constant);
+  }
+  return selected;
+}
+
+#if defined(__x86_64__)
+
+/// For every mask of 8 lanes, the lanes that are set, moved to the front.
+struct CompressTable {
+  alignas(32) uint32_t lanes[256][8];
+
+  CompressTable() {
+    for (uint32_t mask = 0; mask < 256; mask++) {
+      uint32_t count = 0;
+      for (uint32_t lane = 0; lane < 8; lane++) {
+        if (mask & (1u << lane)) {
+          lanes[mask][count++] = lane;
+        }
+      }
+      while (count < 8) {
+        lanes[mask][count++] = 0;
+      }
+    }
+  }
+};
+
+const CompressTable& get_compress_table() {
+  static const CompressTable table;
+  return table;
+}
+
+template <PredicateType op>
+__attribute__((target("avx2"))) size_t select_avx2(const int* values,
+                                                    size_t count, int constant,
+                                                    uint32_t* selection) {
+  const auto& table = get_compress_table();
+  const __m256i constants = _mm256_set1_epi32(constant);
+  // Only == and > exist, the other comparisons negate or swap them
+  constexpr bool negate = op == PredicateType::NE ||
+                          op == PredicateType::LE || op == PredicateType::GE;
+  size_t selected = 0;
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+    __m256i result;
+    if (op == PredicateType::EQ || op == PredicateType::NE) {
+      result = _mm256_cmpeq_epi32(block, constants);
+    } else if (op == PredicateType::GT || op == PredicateType::LE) {
+      result = _mm256_cmpgt_epi32(block, constants);
+    } else {
+      result = _mm256_cmpgt_epi32(constants, block);
+    }
+    uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(result));
+    if (negate) {
+      mask ^= 0xff;
+    }
+    // Writes 8 positions, of which the selected ones come first. This stays
+    // within the selection vector, as selected <= i.
+    __m256i positions = _mm256_add_epi32(
+        _mm256_load_si256(reinterpret_cast<const __m256i*>(table.lanes[mask])),
+        _mm256_set1_epi32(i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(selection + selected),
+                        positions);
+    selected += __builtin_popcount(mask);
+  }
+  return selected + select_scalar<op>(values + i, count - i, constant, i,
+                                      selection + selected);
+}
+
+template <PredicateType op>
+__attribute__((target("avx512f"))) size_t select_avx512(const int* values,
+                                                        size_t count,
+                                                        int constant,
+                                                        uint32_t* selection) {
+  constexpr int comparison =
+      op == PredicateType::EQ   ? _MM_CMPINT_EQ
+      : op == PredicateType::NE ? _MM_CMPINT_NE
+      : op == PredicateType::LT ? _MM_CMPINT_LT
+      : op == PredicateType::LE ? _MM_CMPINT_LE
+      : op == PredicateType::GT ? _MM_CMPINT_NLE
+                                : _MM_CMPINT_NLT;
+  const __m512i constants = _mm512_set1_epi32(constant);
+  const __m512i step = _mm512_set1_epi32(16);
+  __m512i positions = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+                                        12, 13, 14, 15);
+  size_t selected = 0;
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m512i block = _mm512_loadu_si512(values + i);
+    __mmask16 mask = _mm512_cmp_epi32_mask(block, constants, comparison);
+    _mm512_mask_compressstoreu_epi32(selection + selected, mask, positions);
+    selected += __builtin_popcount(mask);
+    positions = _mm512_add_epi32(positions, step);
+  }
+  return selected + select_scalar<op>(values + i, count - i, constant, i,
+                                      selection + selected);
+}
+
+#endif
+
+}  // namespace
+
+bool is_supported(FilterKernel kernel) {
+  switch (kernel) {
+    case FilterKernel::SCALAR:
+      return true;
+#if defined(__x86_64__)
+    case FilterKernel::AVX2:
+      return __builtin_cpu_supports("avx2");
+    case FilterKernel::AVX512:
+      return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+      return false;
+  }
+}
+
+FilterKernel get_best_kernel() {
+  static const FilterKernel kernel = []() {
+    if (is_supported(FilterKernel::AVX512)) {
+      return FilterKernel::AVX512;
+    }
+    if (is_supported(FilterKernel::AVX2)) {
+      return FilterKernel::AVX2;
+    }
+    return FilterKernel::SCALAR;
+  }();
+  return kernel;
+}
+
+size_t select(const int* values, size_t count, PredicateType op, int constant,
+              uint32_t* selection) {
+  return select(get_best_kernel(), values, count, op, constant, selection);
+}
+
+size_t select(FilterKernel kernel, const int* values, size_t count,
+              PredicateType op, int constant, uint32_t* selection) {
+  return dispatch(op, [&](auto op_tag) -> size_t {
+    constexpr PredicateType op_value = decltype(op_tag)::value;
+    switch (kernel) {
+#if defined(__x86_64__)
+      case FilterKernel::AVX512:
+        return select_avx512<op_value>(values, count, constant, selection);
+      case FilterKernel::AVX2:
+        return select_avx2<op_value>(values, count, constant, selection);
+#endif
+      default:
+        return select_scalar<op_value>(values, count, constant, 0, selection);
+    }
+  });
+}
+
+}  // namespace operators
+}  // namespace buzzdb
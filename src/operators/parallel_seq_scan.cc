@@ -0,0 +1,157 @@
+#include "operators/parallel_seq_scan.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+#include "heap/storage_context.h"
+#include "operators/seq_scan.h"
+
+namespace buzzdb {
+namespace operators {
+
+MorselScheduler::MorselScheduler(uint64_t num_pages, uint64_t morsel_pages,
+                                 size_t worker_count)
+    : queues_(new Queue[worker_count]), worker_count_(worker_count) {
+  uint64_t morsel_count = (num_pages + morsel_pages - 1) / morsel_pages;
+  for (uint64_t i = 0; i < morsel_count; i++) {
+    uint64_t first_page = i * morsel_pages;
+    Morsel morsel{first_page, std::min(first_page + morsel_pages, num_pages)};
+    // Neighbouring morsels go to the same worker, so that it scans
+    // sequentially until it has to steal
+    queues_[i * worker_count / morsel_count].morsels.push_back(morsel);
+  }
+}
+
+MorselScheduler::MorselScheduler(uint64_t num_pages, uint64_t morsel_pages,
+                                 size_t queue_count,
+                                 const QueueFunction& get_queue)
+    : queues_(new Queue[queue_count]), worker_count_(queue_count) {
+  for (uint64_t first_page = 0; first_page < num_pages;
+       first_page += morsel_pages) {
+    Morsel morsel{first_page, std::min(first_page + morsel_pages, num_pages)};
+    queues_[get_queue(morsel)].morsels.push_back(morsel);
+  }
+}
+
+bool MorselScheduler::next(size_t worker_id, Morsel& morsel) {
+  {
+    Queue& queue = queues_[worker_id];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.morsels.empty()) {
+      morsel = queue.morsels.front();
+      queue.morsels.pop_front();
+      return true;
+    }
+  }
+  // Morsels are never added, so one round over the other queues suffices
+  for (size_t i = 1; i < worker_count_; i++) {
+    Queue& victim = queues_[(worker_id + i) % worker_count_];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.morsels.empty()) {
+      morsel = victim.morsels.back();
+      victim.morsels.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+ParallelSeqScan::ParallelSeqScan(uint16_t table_id, uint64_t num_pages,
+                                 uint64_t num_fields, size_t thread_count) {
+  auto& context = StorageContext::get_default();
+  _own_heap_segment.reset(new HeapSegment(table_id, context.get_log_manager(),
+                                          context.get_buffer_manager()));
+  _heap_segment = _own_heap_segment.get();
+  _num_pages = num_pages;
+  _num_fields = num_fields;
+  set_thread_count(thread_count);
+}
+
+ParallelSeqScan::ParallelSeqScan(HeapSegment& heap_segment, uint64_t num_pages,
+                                 uint64_t num_fields, size_t thread_count) {
+  _heap_segment = &heap_segment;
+  _num_pages = num_pages;
+  _num_fields = num_fields;
+  set_thread_count(thread_count);
+}
+
+void ParallelSeqScan::set_thread_count(size_t thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  uint64_t morsel_count = (_num_pages + MORSEL_PAGES - 1) / MORSEL_PAGES;
+  _thread_count = std::max<uint64_t>(1, std::min<uint64_t>(thread_count,
+                                                           morsel_count));
+}
+
+void ParallelSeqScan::run(const Consumer& consumer) {
+  BufferManager& buffer_manager = _heap_segment->buffer_manager_;
+  std::unique_ptr<MorselScheduler> scheduler;
+  if (buffer_manager.get_partition_count() > 1) {
+    // Morsels never span two partitions, so their first page decides
+    uint16_t segment_id = _heap_segment->segment_id_;
+    scheduler.reset(new MorselScheduler(
+        _num_pages, MORSEL_PAGES, buffer_manager.get_partition_count(),
+        [&buffer_manager, segment_id](const Morsel& morsel) {
+          return buffer_manager.get_partition_of_page(
+              BufferManager::get_overall_page_id(segment_id,
+                                                 morsel.first_page));
+        }));
+  } else {
+    scheduler.reset(
+        new MorselScheduler(_num_pages, MORSEL_PAGES, _thread_count));
+  }
+  if (_thread_count == 1) {
+    run_worker(0, *scheduler, consumer);
+    return;
+  }
+
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  std::vector<std::thread> workers;
+  for (size_t worker_id = 0; worker_id < _thread_count; worker_id++) {
+    workers.emplace_back([&, worker_id]() {
+      try {
+        run_worker(worker_id, *scheduler, consumer);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void ParallelSeqScan::run_worker(size_t worker_id, MorselScheduler& scheduler,
+                                 const Consumer& consumer) {
+  // Every worker has a scan, and so a ring, of its own
+  SeqScan scan(*_heap_segment, _num_pages, _num_fields);
+  scan.set_predicates(_predicates);
+  ColumnBatch batch(_num_fields);
+  BufferManager& buffer_manager = _heap_segment->buffer_manager_;
+  bool partitioned = buffer_manager.get_partition_count() > 1;
+  Morsel morsel;
+  // The thread may migrate to another node, so look up its partition for
+  // every morsel
+  while (scheduler.next(
+      partitioned ? buffer_manager.get_local_partition() : worker_id,
+      morsel)) {
+    scan.set_page_range(morsel.first_page, morsel.end_page);
+    while (scan.next_batch(batch)) {
+      consumer(worker_id, batch);
+    }
+  }
+  scan.close();
+}
+
+}  // namespace operators
+}  // namespace buzzdb
@@ -1,88 +1,339 @@
 
 #include "operators/seq_scan.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <functional>
 #include <string>
+#include <utility>
 
 #include "common/macros.h"
+#include "heap/storage_context.h"
 
-#define UNUSED(p) ((void)(p))
 namespace buzzdb {
 namespace operators {
 
 SeqScan::SeqScan(uint16_t table_id, uint64_t num_pages, uint64_t num_fields){
-  _table_id = table_id;
-  _num_pages = num_pages;
-  _num_fields = num_fields;
-  _buffer_manager = new BufferManager (buzzdb::BUFFER_PAGE_SIZE, buzzdb::BUFFER_PAGE_COUNT);
-  const char* LOG_FILE = buzzdb::LOG_FILE_PATH.c_str();
-	auto logfile = buzzdb::File::open_file(LOG_FILE, buzzdb::File::WRITE);
-	LogManager log_manager(logfile.get());
-	_heap_segment = new HeapSegment (_table_id, log_manager, *_buffer_manager);
+	_table_id = table_id;
+	_num_pages = num_pages;
+	_num_fields = num_fields;
+	auto& context = StorageContext::get_default();
+	_own_heap_segment.reset(new HeapSegment(_table_id,
+			context.get_log_manager(), context.get_buffer_manager()));
+	_heap_segment = _own_heap_segment.get();
+	_buffer_manager = &context.get_buffer_manager();
+}
+
+SeqScan::SeqScan(HeapSegment& heap_segment, uint64_t num_pages,
+		uint64_t num_fields){
+	_table_id = heap_segment.segment_id_;
+	_num_pages = num_pages;
+	_num_fields = num_fields;
+	_heap_segment = &heap_segment;
+	_buffer_manager = &heap_segment.buffer_manager_;
 }
 
 void SeqScan::open(){
-  // read from catalog
-  _curr_segment = 0;
-  _curr_slot = 0;
+	// read from catalog
+	release_page();
+	_curr_segment = _first_page;
+	_curr_slot = 0;
 }
 void SeqScan::reset(){
-  _curr_segment = 0;
-  _curr_slot = 0;
+	release_page();
+	_curr_segment = _first_page;
+	_curr_slot = 0;
+}
+
+void SeqScan::set_page_range(uint64_t first_page, uint64_t end_page){
+	_first_page = first_page;
+	_num_pages = end_page;
+	reset();
 }
 
 SeqScan::~SeqScan(){
+	release_page();
 }
 
 void SeqScan::close(){
-  delete _buffer_manager;
-  delete _heap_segment;
+	// The buffer pool and the segment outlive the scan
+	release_page();
+}
+
+void SeqScan::prefetch_next_pages(){
+	if (_curr_slot == 0 &&
+			(_curr_segment % BufferManager::READ_AHEAD_PAGES == 0 ||
+					_curr_segment == _first_page)) {
+		// Read the next pages of the scan with one batch of requests
+		_buffer_manager->prefetch_pages(_heap_segment->segment_id_,
+				_curr_segment,
+				std::min<uint64_t>(BufferManager::READ_AHEAD_PAGES -
+								_curr_segment % BufferManager::READ_AHEAD_PAGES,
+						_num_pages - _curr_segment),
+				&_ring);
+	}
+}
+
+bool SeqScan::may_match(uint64_t segment_page_id){
+	if (!_zone_map || !_zone_map->get_summary(segment_page_id, _summary)) {
+		return true;
+	}
+	if (_summary.tuple_count == 0) {
+		return false;
+	}
+	for (auto& predicate : _predicates) {
+		if (predicate.field < _summary.min.size() &&
+				!may_satisfy(predicate.op, _summary.min[predicate.field],
+						_summary.max[predicate.field], predicate.constant)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SeqScan::fix_current_page(){
+	if (_frame != nullptr) {
+		return true;
+	}
+	while (_curr_segment < _num_pages && _curr_slot == 0 &&
+			!may_match(_curr_segment)) {
+		_curr_segment++;
+	}
+	if (_curr_segment >= _num_pages) {
+		return false;
+	}
+	prefetch_next_pages();
+	uint64_t page_id =
+			BufferManager::get_overall_page_id(
+					_heap_segment->segment_id_, _curr_segment);
+	_frame = &_buffer_manager->fix_page(page_id, false, &_ring);
+	return true;
+}
+
+void SeqScan::release_page(){
+	if (_frame != nullptr) {
+		_buffer_manager->unfix_page(*_frame, false);
+		_frame = nullptr;
+	}
+}
+
+void SeqScan::set_predicates(std::vector<Predicate> predicates){
+	for(UNUSED_ATTRIBUTE auto& predicate : predicates){
+		assert(predicate.field < _num_fields);
+	}
+	_predicates = std::move(predicates);
+	// A segment without a zone map may have a stale one from an earlier
+	// incarnation, which must not be used
+	_zone_map = _predicates.empty() ? nullptr : _heap_segment->zone_map_.get();
+	reset();
+}
+
+bool SeqScan::matches(const TupleView& tuple) const{
+	for(auto& predicate : _predicates){
+		int field;
+		memcpy(&field, tuple.data + predicate.field*sizeof(int), sizeof(int));
+		if(!evaluate(predicate.op, field, predicate.constant)){
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SeqScan::matches(const PaxPage& page, uint16_t row) const{
+	for(auto& predicate : _predicates){
+		if(!evaluate(predicate.op, page.get_column(predicate.field)[row],
+				predicate.constant)){
+			return false;
+		}
+	}
+	return true;
 }
 
 bool SeqScan::has_next(){
-  auto tuple_size = sizeof(int)*_num_fields; //  field1 | field2
-  while(_curr_segment < _num_pages){
-			uint64_t page_id =
-					BufferManager::get_overall_page_id(
-							_heap_segment->segment_id_, _curr_segment);
-
-			BufferFrame &frame = _buffer_manager->fix_page(page_id, true);
-
-			auto* page = reinterpret_cast<SlottedPage*>(frame.get_data());
-			page->header.buffer_frame = reinterpret_cast<char*>(page);
-			auto overall_page_id = page->header.overall_page_id;
-			auto slot_count = page->header.first_free_slot;
-      while(_curr_slot < slot_count){
-				TID tid = TID(overall_page_id, _curr_slot);
-
-				// Check slot
-				std::vector<char> buf;
-				buf.resize(tuple_size);
-				int field;
-
-				_heap_segment->read(tid, reinterpret_cast<std::byte *>(buf.data()),
-						tuple_size);
-        _tuple.clear();
-        for(size_t i=0; i<_num_fields; i++){
-          memcpy(&field, buf.data() + i*sizeof(int), sizeof(int));
-          _tuple.push_back(field);
-        }
-				
-        _curr_slot++;
-
-        _buffer_manager->unfix_page(frame, true);
-        return true;
-      }
-      _buffer_manager->unfix_page(frame, true);
-      _curr_segment++;
-      _curr_slot = 0;
-    }
-  return false;
-}
-	
+	while(_curr_segment < _num_pages){
+		// The page stays fixed until the scan moves past its last record
+		if(!fix_current_page()){
+			break;
+		}
+
+		if(PaxPage::is_pax_page(_frame->get_data())){
+			auto* page = reinterpret_cast<PaxPage*>(_frame->get_data());
+			assert(page->header.field_count >= _num_fields);
+			while(_curr_slot < page->header.tuple_count){
+				uint16_t row = _curr_slot++;
+				if(matches(*page, row)){
+					_tuple.resize(_num_fields);
+					for(size_t i=0; i<_num_fields; i++){
+						_tuple[i] = page->get_column(i)[row];
+					}
+					return true;
+				}
+			}
+		} else {
+			auto* page = reinterpret_cast<SlottedPage*>(_frame->get_data());
+			SlottedPage::Iterator it(page, _curr_slot);
+			auto end = page->end();
+			while(it != end && !matches(*it)){
+				++it;
+			}
+			if(it != end){
+				TupleView tuple = *it;
+				_tuple.resize(_num_fields);
+				memcpy(_tuple.data(), tuple.data, sizeof(int)*_num_fields);
+
+				_curr_slot = it.get_slot_id() + 1;
+				return true;
+			}
+		}
+		release_page();
+		_curr_segment++;
+		_curr_slot = 0;
+	}
+	return false;
+}
+
 std::vector<int> SeqScan::get_tuple(){
-  return _tuple;
-  }
+	return _tuple;
+}
+
+size_t SeqScan::apply_predicate(const Predicate& predicate, const int* values,
+		size_t count, bool first){
+	size_t matched = select(values, count, predicate.op, predicate.constant,
+			_matches.data());
+	// The matches are ascending positions into the values, so the selection
+	// can be narrowed in place
+	for(size_t j = 0; j < matched; j++){
+		_selection[j] = first ? _matches[j] : _selection[_matches[j]];
+	}
+	return matched;
+}
+
+size_t SeqScan::filter_records(size_t count){
+	size_t selected = count;
+	for(size_t k = 0; k < _predicates.size() && selected > 0; k++){
+		const Predicate& predicate = _predicates[k];
+		// Gather the field of the records that are still selected into a
+		// dense column, which the kernel filters
+		for(size_t j = 0; j < selected; j++){
+			const std::byte* record = _records[k == 0 ? j : _selection[j]];
+			memcpy(&_values[j], record + predicate.field*sizeof(int), sizeof(int));
+		}
+		selected = apply_predicate(predicate, _values.data(), selected, k == 0);
+	}
+	return selected;
+}
+
+size_t SeqScan::filter_pax_rows(const PaxPage& page, size_t first_row,
+		size_t count){
+	size_t selected = count;
+	for(size_t k = 0; k < _predicates.size() && selected > 0; k++){
+		const Predicate& predicate = _predicates[k];
+		const int* column = page.get_column(predicate.field) + first_row;
+		if(k == 0){
+			// The minipage already is a dense column
+			selected = apply_predicate(predicate, column, count, true);
+			continue;
+		}
+		for(size_t j = 0; j < selected; j++){
+			_values[j] = column[_selection[j]];
+		}
+		selected = apply_predicate(predicate, _values.data(), selected, false);
+	}
+	return selected;
+}
+
+size_t SeqScan::read_slotted_page(ColumnBatch& batch, size_t rows,
+		bool& page_done){
+	auto* page = reinterpret_cast<SlottedPage*>(_frame->get_data());
+	SlottedPage::Iterator it(page, _curr_slot);
+	auto end = page->end();
+	size_t count = 0;
+	for(; it != end && count < batch.capacity() - rows; ++it){
+		_records[count++] = (*it).data;
+	}
+	_curr_slot = it.get_slot_id();
+	page_done = it == end;
+
+	if(_predicates.empty()){
+		for(size_t i=0; i<_num_fields; i++){
+			int* column = batch.column(i) + rows;
+			for(size_t j = 0; j < count; j++){
+				memcpy(&column[j], _records[j] + i*sizeof(int), sizeof(int));
+			}
+		}
+		return count;
+	}
+	size_t selected = filter_records(count);
+	for(size_t i=0; i<_num_fields; i++){
+		int* column = batch.column(i) + rows;
+		for(size_t j = 0; j < selected; j++){
+			memcpy(&column[j], _records[_selection[j]] + i*sizeof(int),
+					sizeof(int));
+		}
+	}
+	return selected;
+}
+
+size_t SeqScan::read_pax_page(ColumnBatch& batch, size_t rows,
+		bool& page_done){
+	auto* page = reinterpret_cast<PaxPage*>(_frame->get_data());
+	assert(page->header.field_count >= _num_fields);
+	size_t first_row = _curr_slot;
+	size_t count = std::min<size_t>(page->header.tuple_count - first_row,
+			batch.capacity() - rows);
+	_curr_slot = first_row + count;
+	page_done = _curr_slot >= page->header.tuple_count;
+
+	if(_predicates.empty()){
+		// Whole runs of every minipage are copied at once
+		for(size_t i=0; i<_num_fields; i++){
+			memcpy(batch.column(i) + rows, page->get_column(i) + first_row,
+					count*sizeof(int));
+		}
+		return count;
+	}
+	size_t selected = filter_pax_rows(*page, first_row, count);
+	for(size_t i=0; i<_num_fields; i++){
+		int* column = batch.column(i) + rows;
+		const int* minipage = page->get_column(i) + first_row;
+		for(size_t j = 0; j < selected; j++){
+			column[j] = minipage[_selection[j]];
+		}
+	}
+	return selected;
+}
+
+bool SeqScan::next_batch(ColumnBatch& batch){
+	assert(batch.num_fields() >= _num_fields);
+	batch.clear();
+	_records.resize(batch.capacity());
+	if(!_predicates.empty()){
+		_values.resize(batch.capacity());
+		_selection.resize(batch.capacity());
+		_matches.resize(batch.capacity());
+	}
+	size_t rows = 0;
+	while(_curr_segment < _num_pages && rows < batch.capacity()){
+		if(!fix_current_page()){
+			break;
+		}
+
+		bool page_done;
+		if(PaxPage::is_pax_page(_frame->get_data())){
+			rows += read_pax_page(batch, rows, page_done);
+		} else {
+			rows += read_slotted_page(batch, rows, page_done);
+		}
+
+		if(page_done){
+			release_page();
+			_curr_segment++;
+			_curr_slot = 0;
+		}
+	}
+	batch.set_size(rows);
+	return rows > 0;
+}
 }  // namespace operators
 }  // namespace buzzdb
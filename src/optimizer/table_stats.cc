@@ -2,6 +2,8 @@
 #include "optimizer/table_stats.h"
 #include <math.h>
 
+#include <algorithm>
+
 namespace buzzdb {
 namespace table_stats {
 
@@ -48,6 +50,17 @@ namespace table_stats {
         ntups += 1;
     }      
     
+    /**
+     * Add the values of another histogram with the same buckets to this one.
+     * @param other Histogram of the same buckets and value range
+     */
+    void IntHistogram::merge(const IntHistogram& other){
+        for (int i = 0; i < NumB; i++){
+            umap[i] += other.umap[i];
+        }
+        ntups += other.ntups;
+    }
+
     /**
      * Estimate the selectivity of a particular predicate and operand on this table.
      * 
@@ -162,54 +175,106 @@ namespace table_stats {
         and build stats. You should try to do this reasonably efficiently, but you don't
         necessarily have to (for example) do everything in a single scan of the table.
     */
-        buzzdb::operators::SeqScan scan(table_id, num_pages, num_fields);
-        scan.open();
+        buzzdb::operators::ParallelSeqScan scan(table_id, num_pages, num_fields);
+        build(scan, io_cost_per_page, num_pages, num_fields);
+    }
+
+    /**
+     * Like the constructor above, but scans the given heap segment instead
+     * of the table of the default storage context.
+     */
+    TableStats::TableStats(HeapSegment& heap_segment, int64_t io_cost_per_page,
+                    uint64_t num_pages, uint64_t num_fields){
+        buzzdb::operators::ParallelSeqScan scan(heap_segment, num_pages, num_fields);
+        build(scan, io_cost_per_page, num_pages, num_fields);
+    }
+
+    void TableStats::build(buzzdb::operators::ParallelSeqScan& scan,
+                    int64_t io_cost_per_page, uint64_t num_pages, uint64_t num_fields){
         io_cost = io_cost_per_page;
         nump = num_pages;
         numf = num_fields;
+
+        // Every worker keeps partial results of its own, which are merged
+        // after each pass
+        size_t worker_count = scan.get_thread_count();
+
         for (int k = 0; k < numf; k++){
             max_value.push_back((-1) * std::numeric_limits<int>::max());
             min_value.push_back(std::numeric_limits<int>::max());
         }
-        
-        std::vector<int> tup(numf);
 
-        while (scan.has_next()) {
-            tup = scan.get_tuple();
+        // The zone map of the segment, if it keeps one, already knows the
+        // value ranges, which saves a pass
+        ZoneMap* zone_map = scan.get_heap_segment().zone_map_.get();
+        PageSummary summary;
+        if (zone_map != nullptr &&
+                zone_map->get_table_summary(num_pages, summary) &&
+                summary.min.size() >= static_cast<size_t>(numf)){
             for(int i = 0; i < numf; i++){
-                if (tup[i] > max_value[i]){
-                    max_value[i] = tup[i];
+                if (summary.tuple_count > 0){
+                    max_value[i] = summary.max[i];
+                    min_value[i] = summary.min[i];
+                }
+            }
+            num_tups = summary.tuple_count;
+        } else {
+            std::vector<std::vector<int>> worker_max(worker_count,
+                    std::vector<int>(numf, (-1) * std::numeric_limits<int>::max()));
+            std::vector<std::vector<int>> worker_min(worker_count,
+                    std::vector<int>(numf, std::numeric_limits<int>::max()));
+            std::vector<uint64_t> worker_tups(worker_count, 0);
+
+            scan.run([&](size_t worker_id, const buzzdb::operators::ColumnBatch& batch) {
+                for(int i = 0; i < numf; i++){
+                    const int* column = batch.column(i);
+                    int max = worker_max[worker_id][i];
+                    int min = worker_min[worker_id][i];
+                    for(size_t row = 0; row < batch.size(); row++){
+                        max = std::max(max, column[row]);
+                        min = std::min(min, column[row]);
+                    }
+                    worker_max[worker_id][i] = max;
+                    worker_min[worker_id][i] = min;
                 }
 
-                if (tup[i] < min_value[i]){
-                    min_value[i] = tup[i];
+                worker_tups[worker_id] += batch.size();
+            });
+
+            for(size_t w = 0; w < worker_count; w++){
+                for(int i = 0; i < numf; i++){
+                    max_value[i] = std::max<int64_t>(max_value[i], worker_max[w][i]);
+                    min_value[i] = std::min<int64_t>(min_value[i], worker_min[w][i]);
                 }
-                
+                num_tups += worker_tups[w];
             }
+        }
 
-            num_tups += 1;
-            
+        std::vector<std::vector<IntHistogram>> worker_hists(worker_count);
+        for(size_t w = 0; w < worker_count; w++){
+            for(int i = 0; i < numf; i++){
+                worker_hists[w].emplace_back(NUM_HIST_BINS, min_value[i], max_value[i]);
+            }
         }
 
-        scan.reset();
-        tup = std::vector<int>(numf);
+        scan.run([&](size_t worker_id, const buzzdb::operators::ColumnBatch& batch) {
+            for(int i = 0; i < numf; i++){
+                const int* column = batch.column(i);
+                IntHistogram& hist = worker_hists[worker_id][i];
+                for(size_t row = 0; row < batch.size(); row++){
+                    hist.add_value(column[row]);
+                }
+            }
+        });
 
         for(int i = 0; i < numf; i++){
             IntHistogram hist(NUM_HIST_BINS, min_value[i], max_value[i]);
-            histmap[i] = hist;    
-        }
-        
-
-        while (scan.has_next()) {
-            tup = scan.get_tuple();
-            for(int i = 0; i < numf; i++){
-                histmap[i].add_value((int)tup[i]);
+            for(size_t w = 0; w < worker_count; w++){
+                hist.merge(worker_hists[w][i]);
             }
-            
+            histmap[i] = hist;    
         }
 
-        scan.close();
-
     }
 
     /**
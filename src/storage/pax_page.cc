@@ -0,0 +1,68 @@
+#include "storage/pax_page.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace buzzdb {
+
+namespace {
+
+/// The minipages start at the first aligned offset after the header
+constexpr uint32_t MINIPAGES_OFFSET =
+    (sizeof(PaxPage::Header) + PaxPage::MINIPAGE_ALIGNMENT - 1) /
+    PaxPage::MINIPAGE_ALIGNMENT * PaxPage::MINIPAGE_ALIGNMENT;
+
+/// Values that fill the alignment unit of a minipage
+constexpr uint32_t VALUES_PER_ALIGNMENT =
+    PaxPage::MINIPAGE_ALIGNMENT / sizeof(int);
+
+}  // namespace
+
+PaxPage::Header::Header(uint32_t page_size, uint16_t _field_count) {
+  overall_page_id = -1;
+  magic = MAGIC;
+  field_count = _field_count;
+  tuple_count = 0;
+  capacity = get_capacity(page_size, _field_count);
+}
+
+PaxPage::PaxPage(uint32_t page_size, uint16_t field_count)
+    : header(page_size, field_count) {}
+
+uint16_t PaxPage::get_capacity(uint32_t page_size, uint16_t field_count) {
+  assert(field_count > 0);
+  uint32_t capacity =
+      (page_size - MINIPAGES_OFFSET) / (field_count * sizeof(int));
+  // Round down, so that every minipage starts aligned
+  capacity = capacity / VALUES_PER_ALIGNMENT * VALUES_PER_ALIGNMENT;
+  return capacity > UINT16_MAX ? UINT16_MAX / VALUES_PER_ALIGNMENT *
+                                     VALUES_PER_ALIGNMENT
+                               : capacity;
+}
+
+bool PaxPage::is_pax_page(const char *data) {
+  uint64_t magic;
+  memcpy(&magic, data + offsetof(Header, magic), sizeof(magic));
+  return magic == MAGIC;
+}
+
+int *PaxPage::get_column(uint16_t field) {
+  return reinterpret_cast<int *>(reinterpret_cast<char *>(this) +
+                                 MINIPAGES_OFFSET) +
+         static_cast<size_t>(field) * header.capacity;
+}
+
+const int *PaxPage::get_column(uint16_t field) const {
+  return const_cast<PaxPage *>(this)->get_column(field);
+}
+
+TID PaxPage::add_tuple(const int *fields) {
+  assert(!is_full());
+  uint16_t row = header.tuple_count++;
+  for (uint16_t field = 0; field < header.field_count; field++) {
+    get_column(field)[row] = fields[field];
+  }
+  return TID(header.overall_page_id, row);
+}
+
+}  // namespace buzzdb
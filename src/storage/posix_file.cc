@@ -1,14 +1,17 @@
 
 #include <fcntl.h>
 #include <stdlib.h>  // NOLINT
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cerrno>
 #include <memory>
 #include <system_error>
 
 #include "storage/file.h"
+#include "storage/posix_file.h"
 
 namespace buzzdb {
 
@@ -20,100 +23,199 @@ namespace {
 
 }  // namespace
 
-class PosixFile : public File {
- private:
-  Mode mode;
-  int fd;
-  size_t cached_size;
+size_t PosixFile::read_size() {
+  struct ::stat file_stat;
+  if (::fstat(fd, &file_stat) < 0) {
+    throw_errno();
+  }
+  return file_stat.st_size;
+}
 
-  size_t read_size() {
-    struct ::stat file_stat;
-    if (::fstat(fd, &file_stat) < 0) {
-      throw_errno();
-    }
-    return file_stat.st_size;
+PosixFile::PosixFile(Mode mode, int fd, size_t size)
+    : mode(mode), fd(fd), cached_size(size) {}
+
+PosixFile::PosixFile(const char* filename, Mode mode, IOMode io_mode)
+    : mode(mode), io_mode(io_mode) {
+  int flags = 0;
+  switch (mode) {
+    case READ:
+      flags = O_RDONLY;
+      break;
+    case WRITE:
+      flags = O_RDWR | O_CREAT;
+  }
+  switch (io_mode) {
+    case IOMode::SYNC:
+      flags |= O_SYNC;
+      break;
+    case IOMode::DSYNC:
+      flags |= O_DSYNC;
+      break;
+    case IOMode::BUFFERED:
+      break;
+    case IOMode::DIRECT:
+      flags |= O_DIRECT;
   }
+  fd = ::open(filename, flags, 0666);
+  if (fd < 0 && errno == EINVAL && io_mode == IOMode::DIRECT) {
+    // The file system does not support direct I/O (e.g. tmpfs)
+    this->io_mode = IOMode::BUFFERED;
+    fd = ::open(filename, flags & ~O_DIRECT, 0666);
+  }
+  if (fd < 0) {
+    throw_errno();
+  }
+  cached_size = read_size();
+}
 
- public:
-  PosixFile(Mode mode, int fd, size_t size)
-      : mode(mode), fd(fd), cached_size(size) {}
+PosixFile::~PosixFile() {
+  // Don't check return value here, as we don't want a throwing
+  // destructor. Also, even when close() fails, the fd will always be
+  // freed (see man 2 close).
+  if (mapping != nullptr) {
+    ::munmap(mapping, mapping_size);
+  }
+  ::close(fd);
+}
 
-  PosixFile(const char* filename, Mode mode) : mode(mode) {
-    switch (mode) {
-      case READ:
-        fd = ::open(filename, O_RDONLY | O_SYNC);
-        break;
-      case WRITE:
-        fd = ::open(filename, O_RDWR | O_CREAT | O_SYNC, 0666);
+const char* PosixFile::map_read_only() {
+  if (mapping != nullptr) {
+    return static_cast<const char*>(mapping);
+  }
+  size_t file_size = cached_size;
+  if (file_size == 0) {
+    return nullptr;
+  }
+  void* new_mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (new_mapping == MAP_FAILED) {
+    return nullptr;
+  }
+  mapping = new_mapping;
+  mapping_size = file_size;
+  return static_cast<const char*>(mapping);
+}
+
+void PosixFile::advise(size_t offset, size_t size, AccessAdvice advice) {
+  if (mapping != nullptr) {
+    if (offset >= mapping_size) {
+      return;
     }
-    if (fd < 0) {
-      throw_errno();
+    // madvise() needs a start address that is aligned to the OS page size
+    size_t os_page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t aligned_offset = offset - offset % os_page_size;
+    size_t length = std::min(offset + size, mapping_size) - aligned_offset;
+    int mapping_advice = MADV_NORMAL;
+    switch (advice) {
+      case AccessAdvice::NORMAL:
+        mapping_advice = MADV_NORMAL;
+        break;
+      case AccessAdvice::SEQUENTIAL:
+        mapping_advice = MADV_SEQUENTIAL;
+        break;
+      case AccessAdvice::RANDOM:
+        mapping_advice = MADV_RANDOM;
+        break;
+      case AccessAdvice::WILLNEED:
+        mapping_advice = MADV_WILLNEED;
+        break;
     }
-    cached_size = read_size();
+    // The advice is only a hint, so errors are ignored
+    ::madvise(static_cast<char*>(mapping) + aligned_offset, length,
+              mapping_advice);
+    return;
   }
 
-  ~PosixFile() override {
-    // Don't check return value here, as we don't want a throwing
-    // destructor. Also, even when close() fails, the fd will always be
-    // freed (see man 2 close).
-    ::close(fd);
+  int file_advice = POSIX_FADV_NORMAL;
+  switch (advice) {
+    case AccessAdvice::NORMAL:
+      file_advice = POSIX_FADV_NORMAL;
+      break;
+    case AccessAdvice::SEQUENTIAL:
+      file_advice = POSIX_FADV_SEQUENTIAL;
+      break;
+    case AccessAdvice::RANDOM:
+      file_advice = POSIX_FADV_RANDOM;
+      break;
+    case AccessAdvice::WILLNEED:
+      file_advice = POSIX_FADV_WILLNEED;
+      break;
   }
+  ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size),
+                  file_advice);
+}
 
-  Mode get_mode() const override { return mode; }
+void PosixFile::resize(size_t new_size) {
+  if (new_size == cached_size) {
+    return;
+  }
+  if (::ftruncate(fd, new_size) < 0) {
+    throw_errno();
+  }
+  cached_size = new_size;
+}
 
-  size_t size() const override { return cached_size; }
+void PosixFile::extend_cached_size(size_t end) {
+  size_t current_size = cached_size;
+  while (current_size < end &&
+         !cached_size.compare_exchange_weak(current_size, end)) {
+  }
+}
 
-  void resize(size_t new_size) override {
-    if (new_size == cached_size) {
+void PosixFile::read_block(size_t offset, size_t size, char* block) {
+  size_t total_bytes_read = 0;
+  while (total_bytes_read < size) {
+    ssize_t bytes_read =
+        ::pread(fd, block + total_bytes_read, size - total_bytes_read,
+                offset + total_bytes_read);
+    if (bytes_read == 0) {
+      // end of file, i.e. size was probably larger than the file
+      // size
       return;
     }
-    if (::ftruncate(fd, new_size) < 0) {
+    if (bytes_read < 0) {
       throw_errno();
     }
-    cached_size = new_size;
-  }
-
-  void read_block(size_t offset, size_t size, char* block) override {
-    size_t total_bytes_read = 0;
-    while (total_bytes_read < size) {
-      ssize_t bytes_read =
-          ::pread(fd, block + total_bytes_read, size - total_bytes_read,
-                  offset + total_bytes_read);
-      if (bytes_read == 0) {
-        // end of file, i.e. size was probably larger than the file
-        // size
-        return;
-      }
-      if (bytes_read < 0) {
-        throw_errno();
-      }
-      total_bytes_read += static_cast<size_t>(bytes_read);
-    }
+    total_bytes_read += static_cast<size_t>(bytes_read);
   }
+}
 
-  void write_block(const char* block, size_t offset, size_t size) override {
-    size_t total_bytes_written = 0;
-    while (total_bytes_written < size) {
-      ssize_t bytes_written =
-          ::pwrite(fd, block + total_bytes_written, size - total_bytes_written,
-                   offset + total_bytes_written);
-      if (bytes_written == 0) {
-        // This should probably never happen. Return here to prevent
-        // an infinite loop.
-        return;
-      }
-      if (bytes_written < 0) {
-        throw_errno();
-      }
-      total_bytes_written += static_cast<size_t>(bytes_written);
+void PosixFile::write_block(const char* block, size_t offset, size_t size) {
+  size_t total_bytes_written = 0;
+  while (total_bytes_written < size) {
+    ssize_t bytes_written =
+        ::pwrite(fd, block + total_bytes_written, size - total_bytes_written,
+                 offset + total_bytes_written);
+    if (bytes_written == 0) {
+      // This should probably never happen. Stop here to prevent
+      // an infinite loop.
+      break;
+    }
+    if (bytes_written < 0) {
+      throw_errno();
     }
+    total_bytes_written += static_cast<size_t>(bytes_written);
   }
-};
+  extend_cached_size(offset + total_bytes_written);
+}
+
+void PosixFile::sync() {
+  if (io_mode == IOMode::SYNC || io_mode == IOMode::DSYNC) {
+    return;
+  }
+  if (::fdatasync(fd) < 0) {
+    throw_errno();
+  }
+}
 
 std::unique_ptr<File> File::open_file(const char* filename, Mode mode) {
   return std::make_unique<PosixFile>(filename, mode);
 }
 
+std::unique_ptr<File> File::open_file(const char* filename, Mode mode,
+                                      IOMode io_mode) {
+  return std::make_unique<PosixFile>(filename, mode, io_mode);
+}
+
 std::unique_ptr<File> File::make_temporary_file() {
   char file_template[] = ".tmpfile-XXXXXX";
   int fd = ::mkstemp(file_template);
@@ -0,0 +1,63 @@
+#include "storage/schema.h"
+
+#include <cassert>
+#include <utility>
+
+namespace buzzdb {
+
+uint32_t get_fixed_width(ColumnType type) {
+  switch (type) {
+    case ColumnType::INT32:
+      return ColumnTraits<ColumnType::INT32>::FIXED_SIZE;
+    case ColumnType::INT64:
+      return ColumnTraits<ColumnType::INT64>::FIXED_SIZE;
+    case ColumnType::VARCHAR:
+      return ColumnTraits<ColumnType::VARCHAR>::FIXED_SIZE;
+  }
+  assert(false);
+  return 0;
+}
+
+Schema::Schema(std::vector<Column> columns)
+    : columns_(std::move(columns)),
+      offsets_(columns_.size()),
+      null_bits_(columns_.size(), NOT_NULLABLE) {
+  assert(!columns_.empty());
+
+  // Widest fields first, so that every field is as aligned as the ones
+  // before it
+  uint32_t offset = 0;
+  for (uint32_t width : {sizeof(int64_t), sizeof(int32_t)}) {
+    for (uint16_t column = 0; column < columns_.size(); column++) {
+      if (get_fixed_width(columns_[column].type) == width) {
+        offsets_[column] = offset;
+        offset += width;
+      }
+    }
+  }
+
+  null_bitmap_offset_ = offset;
+  uint16_t nullable_count = 0;
+  for (uint16_t column = 0; column < columns_.size(); column++) {
+    if (columns_[column].nullable) {
+      null_bits_[column] = nullable_count++;
+    }
+  }
+  offset += (nullable_count + 7) / 8;
+
+  offset_array_offset_ = offset;
+  for (uint16_t column = 0; column < columns_.size(); column++) {
+    if (get_fixed_width(columns_[column].type) == 0) {
+      offsets_[column] = offset;
+      offset += sizeof(uint16_t);
+      varlen_columns_.push_back(column);
+    }
+  }
+  if (!varlen_columns_.empty()) {
+    // The end of the last field
+    offset += sizeof(uint16_t);
+  }
+  fixed_size_ = offset;
+}
+
+}  // namespace buzzdb
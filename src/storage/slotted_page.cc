@@ -79,8 +79,8 @@ std::ostream &buzzdb::operator<<(std::ostream &os, SlottedPage const &p) {
   os << "Slot List: ";
   os << " (" << p.header.slot_count << " slots)\n";
 
-  auto slots = reinterpret_cast<buzzdb::SlottedPage::Slot *>(
-      p.header.buffer_frame + sizeof(p.header));
+  auto slots = reinterpret_cast<const buzzdb::SlottedPage::Slot *>(
+      reinterpret_cast<const char *>(&p) + sizeof(p.header));
   for (uint16_t slot_itr = 0; slot_itr < p.header.slot_count; slot_itr++) {
     os << slot_itr << " :: " << slots[slot_itr];
   }
@@ -89,75 +89,241 @@ std::ostream &buzzdb::operator<<(std::ostream &os, SlottedPage const &p) {
   return os;
 }
 
-void SlottedPage::compactify(UNUSED_ATTRIBUTE uint32_t page_size) {}
+void SlottedPage::compactify(uint32_t page_size) {
+  auto *slots = get_slots();
+  std::vector<uint16_t> records;
+  for (uint16_t slot_id = 0; slot_id < header.slot_count; slot_id++) {
+    if (slots[slot_id].is_record()) {
+      records.push_back(slot_id);
+    }
+  }
+
+  // Moving the records in descending order of their offsets never overwrites
+  // a record that was not moved yet
+  std::sort(records.begin(), records.end(), [slots](uint16_t a, uint16_t b) {
+    return slots[a].get_offset() > slots[b].get_offset();
+  });
+  char *data = reinterpret_cast<char *>(this);
+  uint32_t data_start = page_size;
+  for (uint16_t slot_id : records) {
+    Slot &slot = slots[slot_id];
+    uint32_t length = slot.get_length();
+    data_start -= length;
+    memmove(data + data_start, data + slot.get_offset(), length);
+    slot.value = make_slot(data_start, length, slot.is_moved());
+  }
+  header.data_start = data_start;
+
+  // Drop the free slots at the end, and link the others in ascending order
+  while (header.slot_count > 0 && slots[header.slot_count - 1].is_empty()) {
+    header.slot_count--;
+  }
+  header.first_free_slot = header.slot_count;
+  for (uint16_t slot_id = header.slot_count; slot_id-- > 0;) {
+    if (slots[slot_id].is_empty()) {
+      freeSlot(slot_id);
+    }
+  }
+
+  header.free_space = get_contiguous_space();
+}
+
+buzzdb::SlottedPage::Slot *SlottedPage::get_slots() {
+  // The slot array follows the header. Use the location of the page itself
+  // instead of header.buffer_frame, which is stale after the page was
+  // loaded into another frame.
+  return reinterpret_cast<Slot *>(reinterpret_cast<char *>(this) +
+                                  sizeof(header));
+}
 
 buzzdb::SlottedPage::Slot SlottedPage::getSlot(uint16_t slotId) {
-  auto *slots = reinterpret_cast<Slot *>(header.buffer_frame + sizeof(header));
+  auto *slots = get_slots();
   // std::cout << slots.size() << " "<< slotId <<  std::endl;
   return slots[slotId];
 }
 
+buzzdb::TupleView SlottedPage::get_tuple(uint16_t slot_id) {
+  Slot slot = get_slots()[slot_id];
+  assert(slot.is_record());
+  const auto *data =
+      reinterpret_cast<const std::byte *>(this) + slot.get_offset();
+  if (slot.is_moved()) {
+    // The record is still known by the TID that redirects to it
+    uint64_t original;
+    memcpy(&original, data, sizeof(original));
+    return TupleView{TID(original), data + MOVED_PREFIX,
+                     slot.get_length() - MOVED_PREFIX};
+  }
+  return TupleView{TID(header.overall_page_id, slot_id), data,
+                   slot.get_length()};
+}
+
+SlottedPage::Iterator SlottedPage::begin() { return Iterator(this, 0); }
+
+SlottedPage::Iterator SlottedPage::end() {
+  return Iterator(this, header.slot_count);
+}
+
+SlottedPage::Iterator::Iterator(SlottedPage *page, uint16_t slot_id)
+    : page_(page), slot_id_(slot_id) {
+  skip_non_records();
+}
+
+SlottedPage::Iterator &SlottedPage::Iterator::operator++() {
+  slot_id_++;
+  skip_non_records();
+  return *this;
+}
+
+void SlottedPage::Iterator::skip_non_records() {
+  auto *slots = page_->get_slots();
+  while (slot_id_ < page_->header.slot_count && !slots[slot_id_].is_record()) {
+    slot_id_++;
+  }
+}
+
 void SlottedPage::setSlot(uint16_t slotId, uint64_t value) {
-  auto *slots = reinterpret_cast<Slot *>(header.buffer_frame + sizeof(header));
+  auto *slots = get_slots();
   slots[slotId].value = value;
 }
 
-TID SlottedPage::addSlot(uint32_t size) {
-  uint64_t t = ~0;
-  uint64_t s = 0;
-  uint64_t offset = header.data_start - size;
-  uint64_t length = size;
+uint64_t SlottedPage::make_slot(uint32_t offset, uint32_t length,
+                                bool moved) {
+  uint64_t t = RECORD_TAG;
+  uint64_t s = moved ? 1 : 0;
 
-  // update data_start
-  header.data_start = offset;
+  uint64_t slotValue = 0;
+  slotValue += t << 56;
+  slotValue += s << 56 >> 8;
+  slotValue += (uint64_t{offset} << 40 >> 16);
+  slotValue += (uint64_t{length} << 40 >> 40);
+  return slotValue;
+}
+
+uint32_t SlottedPage::get_required_space(uint32_t size) const {
+  bool new_slot = header.first_free_slot == header.slot_count;
+  return size + (new_slot ? sizeof(Slot) : 0);
+}
+
+uint32_t SlottedPage::get_contiguous_space() const {
+  return header.data_start - header.slot_count * sizeof(Slot) -
+         sizeof(header);
+}
 
-  if (size > header.free_space) {
+TID SlottedPage::addSlot(uint32_t size) {
+  uint32_t required_space = get_required_space(size);
+  if (required_space > header.free_space) {
     std::cout << "No space in page to add slot \n";
     std::cout << *this;
     std::cout << "free space: " << header.free_space << "\n";
     std::cout << "requested size: " << size << "\n";
     exit(0);
   }
+  // The caller compactifies the page, which knows the page size
+  assert(required_space <= get_contiguous_space());
 
-  uint64_t slotValue = 0;
-  slotValue += t << 56;
-  slotValue += s << 56 >> 8;
-  slotValue += (offset << 40 >> 16);
-  slotValue += (length << 40 >> 40);
+  uint64_t offset = header.data_start - size;
 
-  Slot newSlot;
-  newSlot.value = slotValue;
+  // update data_start
+  header.data_start = offset;
 
-  auto *slots = reinterpret_cast<Slot *>(header.buffer_frame + sizeof(header));
+  auto *slots = get_slots();
 
-  // Add slot at end
-  if (header.first_free_slot == header.slot_count) {
-    slots[header.slot_count].value = slotValue;
+  // Reuse the head of the free list, or add the slot at the end
+  uint16_t slot_id = header.first_free_slot;
+  if (slot_id == header.slot_count) {
     header.slot_count++;
+    header.first_free_slot = header.slot_count;
   } else {
-    // Update existing slot
-    slots[header.first_free_slot].value = slotValue;
+    uint64_t next = slots[slot_id].value & FREE_LINK_MASK;
+    header.first_free_slot = next ? next - 1 : header.slot_count;
   }
+  slots[slot_id].value = make_slot(offset, size, false);
 
   // Update free space
-  uint32_t slot_space = header.slot_count * sizeof(Slot);
-  header.free_space = header.data_start - slot_space - sizeof(header);
-
-  TID new_tid = TID(header.overall_page_id, header.first_free_slot);
-
-  bool found_empty_slot = false;
-  for (uint16_t slot_itr = 0; slot_itr < header.slot_count; slot_itr++) {
-    Slot l = slots[slot_itr];
-    if (l.value == 0) {
-      found_empty_slot = true;
-      header.first_free_slot = slot_itr;
-      break;
+  header.free_space -= required_space;
+
+  TID new_tid = TID(header.overall_page_id, slot_id);
+
+  return new_tid;
+}
+
+void SlottedPage::freeSlot(uint16_t slotId) {
+  auto *slots = get_slots();
+  // Link the slot in front of the free list, the link is stored +1 so that 0
+  // terminates the list
+  uint64_t next = header.first_free_slot == header.slot_count
+                      ? 0
+                      : header.first_free_slot + 1;
+  slots[slotId].value = (uint64_t{FREE_TAG} << 56) | next;
+  header.first_free_slot = slotId;
+}
+
+void SlottedPage::erase(uint16_t slot_id) {
+  Slot &slot = get_slots()[slot_id];
+  if (slot.is_record()) {
+    uint32_t length = slot.get_length();
+    header.free_space += length;
+    if (slot.get_offset() == header.data_start) {
+      // The record is the lowest one, so its space is contiguous right away
+      header.data_start += length;
     }
   }
+  freeSlot(slot_id);
+}
 
-  if (!found_empty_slot) {
-    header.first_free_slot = header.slot_count;
+bool SlottedPage::resize(uint16_t slot_id, uint32_t size, uint32_t page_size) {
+  Slot &slot = get_slots()[slot_id];
+  assert(slot.is_record());
+  bool moved = slot.is_moved();
+  uint32_t offset = slot.get_offset();
+  uint32_t old_length = slot.get_length();
+  uint32_t length = size + (moved ? MOVED_PREFIX : 0);
+
+  if (length <= old_length) {
+    // Shrink in place, compactify reclaims the tail
+    header.free_space += old_length - length;
+    slot.value = make_slot(offset, length, moved);
+    return true;
+  }
+  if (length > header.free_space + old_length) {
+    return false;
   }
 
-  return new_tid;
+  char *data = reinterpret_cast<char *>(this);
+  if (length <= get_contiguous_space()) {
+    memcpy(data + header.data_start - length, data + offset, old_length);
+  } else {
+    // Compactify the page without the record, and add it back afterwards
+    std::vector<char> record(data + offset, data + offset + old_length);
+    slot.value = make_slot(offset, 0, moved);
+    compactify(page_size);
+    memcpy(data + header.data_start - length, record.data(), old_length);
+    old_length = 0;
+  }
+  header.data_start -= length;
+  header.free_space = header.free_space + old_length - length;
+  slot.value = make_slot(header.data_start, length, moved);
+  return true;
+}
+
+void SlottedPage::redirect(uint16_t slot_id, TID target) {
+  Slot &slot = get_slots()[slot_id];
+  assert(slot.is_record());
+  // The TID must not look like a record or a free slot
+  assert(target.value >> 56 != RECORD_TAG && target.value >> 56 != FREE_TAG);
+  uint32_t length = slot.get_length();
+  header.free_space += length;
+  if (slot.get_offset() == header.data_start) {
+    header.data_start += length;
+  }
+  slot.value = target.value;
+}
+
+void SlottedPage::set_moved(uint16_t slot_id, TID original) {
+  Slot &slot = get_slots()[slot_id];
+  assert(slot.is_record() && slot.get_length() >= MOVED_PREFIX);
+  memcpy(reinterpret_cast<char *>(this) + slot.get_offset(), &original.value,
+         sizeof(original.value));
+  slot.value = make_slot(slot.get_offset(), slot.get_length(), true);
 }
@@ -0,0 +1,79 @@
+#include "storage/tuple.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace buzzdb {
+
+TupleBuilder::TupleBuilder(const Schema &schema)
+    : schema_(schema),
+      prefix_(schema.get_fixed_size()),
+      varlen_(schema.get_varlen_columns().size()) {}
+
+void TupleBuilder::set_null(uint16_t column) {
+  assert(schema_.get_null_bit(column) != Schema::NOT_NULLABLE);
+  set_null_bit(column, true);
+  uint32_t size = get_fixed_width(schema_.get_column(column).type);
+  if (size == 0) {
+    varlen_[get_varlen_index(column)].clear();
+  } else {
+    memset(prefix_.data() + schema_.get_offset(column), 0, size);
+  }
+}
+
+void TupleBuilder::set_null_bit(uint16_t column, bool null) {
+  uint16_t bit = schema_.get_null_bit(column);
+  if (bit == Schema::NOT_NULLABLE) {
+    return;
+  }
+  auto &byte = prefix_[schema_.get_null_bitmap_offset() + bit / 8];
+  auto mask = static_cast<std::byte>(1 << (bit % 8));
+  byte = null ? byte | mask : byte & ~mask;
+}
+
+uint32_t TupleBuilder::get_size() const {
+  uint32_t size = prefix_.size();
+  for (auto &value : varlen_) {
+    size += value.size();
+  }
+  if (!varlen_.empty() && size > UINT16_MAX) {
+    throw std::length_error("variable-length fields exceed the tuple offsets");
+  }
+  return size;
+}
+
+void TupleBuilder::write(std::byte *tuple) const {
+  memcpy(tuple, prefix_.data(), prefix_.size());
+
+  // Fill in the offset array while appending the variable-length data
+  uint32_t offset = prefix_.size();
+  std::byte *offsets = tuple + schema_.get_offset_array_offset();
+  for (size_t i = 0; i < varlen_.size(); i++) {
+    assert(offset + varlen_[i].size() <= UINT16_MAX);
+    auto start = static_cast<uint16_t>(offset);
+    memcpy(offsets + i * sizeof(uint16_t), &start, sizeof(start));
+    memcpy(tuple + offset, varlen_[i].data(), varlen_[i].size());
+    offset += varlen_[i].size();
+  }
+  if (!varlen_.empty()) {
+    auto end = static_cast<uint16_t>(offset);
+    memcpy(offsets + varlen_.size() * sizeof(uint16_t), &end, sizeof(end));
+  }
+}
+
+std::vector<std::byte> TupleBuilder::build() const {
+  std::vector<std::byte> tuple(get_size());
+  write(tuple.data());
+  return tuple;
+}
+
+void TupleBuilder::clear() {
+  std::fill(prefix_.begin(), prefix_.end(), std::byte{0});
+  for (auto &value : varlen_) {
+    value.clear();
+  }
+}
+
+}  // namespace buzzdb
@@ -0,0 +1,302 @@
+#include "storage/uring_file.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define BUZZDB_HAS_IO_URING 1
+#else
+#define BUZZDB_HAS_IO_URING 0
+#endif
+
+namespace buzzdb {
+
+#if BUZZDB_HAS_IO_URING
+
+namespace {
+
+[[noreturn]] void throw_error(int error) {
+  throw std::system_error{error, std::system_category()};
+}
+
+int io_uring_setup(unsigned entries, struct io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_register(int ring_fd, unsigned opcode, void* arg,
+                      unsigned arg_count) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_register, ring_fd, opcode, arg, arg_count));
+}
+
+/// Returns true if the ring supports the read and write opcodes. Kernels
+/// before 5.6 have neither them nor the probe, so a failing probe counts as
+/// no support.
+bool supports_read_write(int ring_fd) {
+  constexpr unsigned OP_COUNT = 256;
+  std::vector<char> buffer(sizeof(struct io_uring_probe) +
+                           OP_COUNT * sizeof(struct io_uring_probe_op));
+  auto* probe = reinterpret_cast<struct io_uring_probe*>(buffer.data());
+  if (io_uring_register(ring_fd, IORING_REGISTER_PROBE, probe, OP_COUNT) < 0) {
+    return false;
+  }
+  auto supported = [probe](unsigned op) {
+    return op <= probe->last_op && op < probe->ops_len &&
+           (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+  };
+  return supported(IORING_OP_READ) && supported(IORING_OP_WRITE);
+}
+
+int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete,
+                   unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+}
+
+template <typename T>
+T* ring_field(void* ring, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+}  // namespace
+
+UringFile::UringFile(const char* filename, Mode mode, IOMode io_mode,
+                     unsigned queue_depth)
+    : PosixFile(filename, mode, io_mode) {
+  struct io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ring_fd_ = io_uring_setup(queue_depth, &params);
+  if (ring_fd_ < 0) {
+    throw_error(errno);
+  }
+  if (!supports_read_write(ring_fd_)) {
+    ::close(ring_fd_);
+    throw_error(ENOSYS);
+  }
+  sq_entries_ = params.sq_entries;
+  cq_entries_ = params.cq_entries;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+
+  auto map_ring = [this](size_t size, off_t offset) {
+    void* ring = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+    if (ring == MAP_FAILED) {
+      int error = errno;
+      // The destructor does not run for a throwing constructor
+      release_ring();
+      throw_error(error);
+    }
+    return ring;
+  };
+  sq_ring_ = map_ring(sq_ring_size_, IORING_OFF_SQ_RING);
+  cq_ring_ = single_mmap ? sq_ring_ : map_ring(cq_ring_size_, IORING_OFF_CQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqes_ = map_ring(sqes_size_, IORING_OFF_SQES);
+
+  sq_tail_ = ring_field<unsigned>(sq_ring_, params.sq_off.tail);
+  sq_mask_ = ring_field<unsigned>(sq_ring_, params.sq_off.ring_mask);
+  sq_array_ = ring_field<unsigned>(sq_ring_, params.sq_off.array);
+  cq_head_ = ring_field<unsigned>(cq_ring_, params.cq_off.head);
+  cq_tail_ = ring_field<unsigned>(cq_ring_, params.cq_off.tail);
+  cq_mask_ = ring_field<unsigned>(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = ring_field<void>(cq_ring_, params.cq_off.cqes);
+}
+
+UringFile::~UringFile() {
+  // The kernel may still write into the blocks of requests in flight, so
+  // wait for them before tearing down the ring
+  std::lock_guard<std::mutex> guard(ring_mutex_);
+  while (in_flight_ > 0) {
+    try {
+      enter(true);
+    } catch (const std::system_error&) {
+      break;
+    }
+    reap_completions();
+  }
+  release_ring();
+}
+
+void UringFile::release_ring() {
+  if (sqes_ != nullptr) {
+    ::munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+    ::munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != nullptr) {
+    ::munmap(sq_ring_, sq_ring_size_);
+  }
+  ::close(ring_fd_);
+}
+
+bool UringFile::is_supported() {
+  static const bool supported = [] {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int ring_fd = io_uring_setup(1, &params);
+    if (ring_fd < 0) {
+      return false;
+    }
+    bool read_write = supports_read_write(ring_fd);
+    ::close(ring_fd);
+    return read_write;
+  }();
+  return supported;
+}
+
+void UringFile::push_request(IORequest& request) {
+  // Make room in the completion queue for the new request
+  while (in_flight_ + to_submit_ >= cq_entries_ || to_submit_ == sq_entries_) {
+    enter(in_flight_ > 0);
+    reap_completions();
+  }
+
+  unsigned tail = *sq_tail_;
+  unsigned index = tail & *sq_mask_;
+  auto* sqe = static_cast<struct io_uring_sqe*>(sqes_) + index;
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = (request.type == IORequest::READ) ? IORING_OP_READ
+                                                   : IORING_OP_WRITE;
+  sqe->fd = get_fd();
+  sqe->off = request.offset + request.transferred;
+  sqe->addr = reinterpret_cast<uint64_t>(request.block + request.transferred);
+  sqe->len = static_cast<uint32_t>(request.size - request.transferred);
+  sqe->user_data = reinterpret_cast<uint64_t>(&request);
+  sq_array_[index] = index;
+
+  // Publish the entry to the kernel
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  to_submit_++;
+}
+
+void UringFile::enter(bool wait) {
+  unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+  int submitted = io_uring_enter(ring_fd_, to_submit_, wait ? 1 : 0, flags);
+  if (submitted < 0) {
+    if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+      return;
+    }
+    throw_error(errno);
+  }
+  to_submit_ -= static_cast<unsigned>(submitted);
+  in_flight_ += static_cast<size_t>(submitted);
+}
+
+void UringFile::reap_completions() {
+  while (true) {
+    // Reload the head in every iteration, as resubmitting a request below
+    // may reap completions itself
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      break;
+    }
+    auto* cqe = static_cast<struct io_uring_cqe*>(cqes_) + (head & *cq_mask_);
+    auto* request = reinterpret_cast<IORequest*>(cqe->user_data);
+    int result = cqe->res;
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    in_flight_--;
+
+    if (result == -EINTR || result == -EAGAIN) {
+      push_request(*request);
+    } else if (result < 0) {
+      request->error = -result;
+      request->done = true;
+    } else if (result == 0) {
+      // End of file, or a write that made no progress
+      request->done = true;
+    } else {
+      request->transferred += static_cast<size_t>(result);
+      if (request->type == IORequest::WRITE) {
+        extend_cached_size(request->offset + request->transferred);
+      }
+      if (request->transferred < request->size) {
+        // Short read or write, continue with the rest of the block
+        push_request(*request);
+      } else {
+        request->done = true;
+      }
+    }
+  }
+}
+
+void UringFile::submit(IORequest* requests, size_t count) {
+  std::lock_guard<std::mutex> guard(ring_mutex_);
+  for (size_t i = 0; i < count; i++) {
+    requests[i].transferred = 0;
+    requests[i].error = 0;
+    requests[i].done = false;
+    push_request(requests[i]);
+  }
+  enter(false);
+}
+
+void UringFile::complete(IORequest* requests, size_t count) {
+  std::lock_guard<std::mutex> guard(ring_mutex_);
+  size_t next = 0;
+  while (true) {
+    reap_completions();
+    while (next < count && requests[next].done) {
+      next++;
+    }
+    if (next == count) {
+      break;
+    }
+    // Waiting while holding the mutex makes sure that no other thread reaps
+    // the completion we are waiting for
+    enter(true);
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (requests[i].error != 0) {
+      throw_error(requests[i].error);
+    }
+  }
+}
+
+#else
+
+UringFile::UringFile(const char* filename, Mode mode, IOMode io_mode,
+                     unsigned /*queue_depth*/)
+    : PosixFile(filename, mode, io_mode) {
+  throw std::system_error{ENOSYS, std::system_category()};
+}
+
+UringFile::~UringFile() = default;
+
+void UringFile::submit(IORequest* requests, size_t count) {
+  File::submit(requests, count);
+}
+
+void UringFile::complete(IORequest* requests, size_t count) {
+  File::complete(requests, count);
+}
+
+bool UringFile::is_supported() { return false; }
+
+#endif
+
+std::unique_ptr<File> File::open_async_file(const char* filename, Mode mode,
+                                            IOMode io_mode) {
+  if (UringFile::is_supported()) {
+    return std::make_unique<UringFile>(filename, mode, io_mode);
+  }
+  return File::open_file(filename, mode, io_mode);
+}
+
+}  // namespace buzzdb
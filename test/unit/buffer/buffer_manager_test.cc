@@ -0,0 +1,470 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer/buffer_manager.h"
+#include "common/macros.h"
+#include "storage/file.h"
+
+using buzzdb::BufferFrame;
+using buzzdb::BufferManager;
+using buzzdb::BufferRing;
+using buzzdb::File;
+using buzzdb::ReplacementPolicy;
+
+constexpr uint16_t BUFFER_SEGMENT = 200;
+constexpr size_t PAGE_SIZE = 1024;
+
+namespace {
+
+class BufferManagerTest : public ::testing::TestWithParam<ReplacementPolicy> {
+	void SetUp() {
+		auto file_handle = File::open_file(
+				std::to_string(BUFFER_SEGMENT).c_str(), File::WRITE);
+		file_handle->resize(0);
+	}
+};
+
+uint64_t page(uint64_t segment_page_id) {
+	return BufferManager::get_overall_page_id(BUFFER_SEGMENT, segment_page_id);
+}
+
+TEST_P(BufferManagerTest, EvictDirtyPages) {
+	BufferManager buffer_manager(PAGE_SIZE, 10, GetParam());
+
+	// Write more pages than fit into the buffer
+	for (uint64_t i = 0; i < 50; i++) {
+		BufferFrame& frame = buffer_manager.fix_page(page(i), true);
+		memcpy(frame.get_data(), &i, sizeof(uint64_t));
+		buffer_manager.unfix_page(frame, true);
+	}
+
+	// The evicted pages must have been written back
+	for (uint64_t i = 0; i < 50; i++) {
+		BufferFrame& frame = buffer_manager.fix_page(page(i), false);
+		uint64_t value;
+		memcpy(&value, frame.get_data(), sizeof(uint64_t));
+		EXPECT_EQ(i, value);
+		buffer_manager.unfix_page(frame, false);
+	}
+}
+
+TEST_P(BufferManagerTest, FixedPagesAreNotEvicted) {
+	BufferManager buffer_manager(PAGE_SIZE, 10, GetParam());
+
+	std::vector<BufferFrame*> frames;
+	for (uint64_t i = 0; i < 10; i++) {
+		frames.push_back(&buffer_manager.fix_page(page(i), false));
+	}
+	EXPECT_THROW(buffer_manager.fix_page(page(10), false),
+			buzzdb::buffer_full_error);
+
+	// Unfixing a single page makes room for exactly that page
+	buffer_manager.unfix_page(*frames[3], false);
+	BufferFrame& frame = buffer_manager.fix_page(page(10), false);
+	EXPECT_EQ(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(3)));
+	for (uint64_t i = 0; i < 10; i++) {
+		if (i != 3) {
+			EXPECT_NE(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(i)));
+		}
+	}
+	buffer_manager.unfix_page(frame, false);
+}
+
+TEST_P(BufferManagerTest, ConcurrentExclusiveUpdates) {
+	BufferManager buffer_manager(PAGE_SIZE, 8, GetParam());
+
+	// Every thread increments a counter on each of 20 pages, so the pool has
+	// to evict pages while other threads hold latches
+	std::vector<std::thread> threads;
+	for (size_t thread = 0; thread < 4; thread++) {
+		threads.emplace_back([&buffer_manager]() {
+			for (uint64_t round = 0; round < 50; round++) {
+				for (uint64_t i = 0; i < 20; i++) {
+					BufferFrame& frame = buffer_manager.fix_page(page(i), true);
+					uint64_t counter;
+					memcpy(&counter, frame.get_data(), sizeof(uint64_t));
+					counter++;
+					memcpy(frame.get_data(), &counter, sizeof(uint64_t));
+					buffer_manager.unfix_page(frame, true);
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	for (uint64_t i = 0; i < 20; i++) {
+		BufferFrame& frame = buffer_manager.fix_page(page(i), false);
+		uint64_t counter;
+		memcpy(&counter, frame.get_data(), sizeof(uint64_t));
+		EXPECT_EQ(200u, counter);
+		buffer_manager.unfix_page(frame, false);
+	}
+}
+
+TEST_P(BufferManagerTest, NestedFixes) {
+	BufferManager buffer_manager(PAGE_SIZE, 4, GetParam());
+
+	// The holder of an exclusive latch may fix the page again
+	BufferFrame& frame = buffer_manager.fix_page(page(0), true);
+	BufferFrame& nested = buffer_manager.fix_page(page(0), false);
+	EXPECT_EQ(frame.get_data(), nested.get_data());
+	buffer_manager.unfix_page(nested, false);
+	buffer_manager.unfix_page(frame, true);
+
+	// Other threads can latch the page afterwards
+	std::thread other([&buffer_manager]() {
+		buffer_manager.unfix_page(buffer_manager.fix_page(page(0), true), false);
+	});
+	other.join();
+}
+
+TEST_P(BufferManagerTest, FixPagesInBatch) {
+	BufferManager buffer_manager(PAGE_SIZE, 100, GetParam());
+
+	std::vector<uint64_t> page_ids;
+	for (uint64_t i = 0; i < 80; i++) {
+		page_ids.push_back(page(i));
+	}
+	auto frames = buffer_manager.fix_pages(page_ids, true);
+	ASSERT_EQ(page_ids.size(), frames.size());
+	for (uint64_t i = 0; i < frames.size(); i++) {
+		memcpy(frames[i]->get_data(), &i, sizeof(uint64_t));
+		buffer_manager.unfix_page(*frames[i], true);
+	}
+	buffer_manager.flush_all_pages();
+	buffer_manager.discard_all_pages();
+
+	// Read back a mix of resident and missing pages
+	buffer_manager.unfix_page(buffer_manager.fix_page(page(5), false), false);
+	frames = buffer_manager.fix_pages(page_ids, false);
+	for (uint64_t i = 0; i < frames.size(); i++) {
+		uint64_t value;
+		memcpy(&value, frames[i]->get_data(), sizeof(uint64_t));
+		EXPECT_EQ(i, value);
+		buffer_manager.unfix_page(*frames[i], false);
+	}
+
+	// All pages stay fixed until the batch is complete
+	page_ids.push_back(page(80));
+	for (uint64_t i = 81; i < 110; i++) {
+		page_ids.push_back(page(i));
+	}
+	EXPECT_THROW(buffer_manager.fix_pages(page_ids, false),
+			buzzdb::buffer_full_error);
+	buffer_manager.unfix_page(buffer_manager.fix_page(page(0), true), false);
+}
+
+TEST_P(BufferManagerTest, ReadAhead) {
+	{
+		BufferManager buffer_manager(PAGE_SIZE, 100, GetParam());
+		for (uint64_t i = 0; i < 40; i++) {
+			buffer_manager.unfix_page(buffer_manager.fix_page(page(i), true), true);
+		}
+	}
+
+	// Sequential misses read ahead, random ones do not
+	BufferManager buffer_manager(PAGE_SIZE, 100, GetParam());
+	buffer_manager.unfix_page(buffer_manager.fix_page(page(20), false), false);
+	EXPECT_EQ(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(21)));
+	buffer_manager.unfix_page(buffer_manager.fix_page(page(21), false), false);
+	for (uint64_t i = 22; i < 40; i++) {
+		EXPECT_NE(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(i)));
+	}
+
+	// Explicit prefetches stop at the end of the segment
+	buffer_manager.prefetch_pages(BUFFER_SEGMENT, 5, 50);
+	for (uint64_t i = 5; i < 10; i++) {
+		EXPECT_NE(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(i)));
+	}
+	EXPECT_EQ(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(40)));
+
+	// Prefetched pages are not fixed
+	for (uint64_t i = 0; i < 100; i++) {
+		buffer_manager.unfix_page(buffer_manager.fix_page(page(100 + i), false), false);
+	}
+	EXPECT_EQ(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(5)));
+
+	// Explicit prefetches read at most a read-ahead window, a quarter of
+	// the pool
+	BufferManager small_buffer_manager(PAGE_SIZE, 40, GetParam(), 1);
+	small_buffer_manager.prefetch_pages(BUFFER_SEGMENT, 0, 40);
+	for (uint64_t i = 0; i < 10; i++) {
+		EXPECT_NE(buzzdb::INVALID_FRAME_ID,
+				small_buffer_manager.get_frame_id_of_page(page(i)));
+	}
+	EXPECT_EQ(buzzdb::INVALID_FRAME_ID,
+			small_buffer_manager.get_frame_id_of_page(page(10)));
+}
+
+TEST_P(BufferManagerTest, FramesAreAligned) {
+	// Pages that are not a multiple of the block size are padded
+	BufferManager buffer_manager(PAGE_SIZE + 4, 10, GetParam());
+	for (uint64_t i = 0; i < 10; i++) {
+		auto& frame = buffer_manager.fix_page(page(i), true);
+		auto address = reinterpret_cast<uintptr_t>(frame.get_data());
+		EXPECT_EQ(0u, address % buzzdb::FrameArena::ALIGNMENT);
+		std::memset(frame.get_data(), 1, PAGE_SIZE + 4);
+		buffer_manager.unfix_page(frame, false);
+	}
+
+	// Discarded frames read as zero
+	buffer_manager.discard_all_pages();
+	auto& frame = buffer_manager.fix_page(page(20), false);
+	EXPECT_EQ(0, frame.get_data()[0]);
+	EXPECT_EQ(0, frame.get_data()[PAGE_SIZE + 3]);
+	buffer_manager.unfix_page(frame, false);
+}
+
+TEST_P(BufferManagerTest, BackgroundWriter) {
+	BufferManager buffer_manager(PAGE_SIZE, 100, GetParam());
+	// A page that is fixed exclusively is not written
+	auto& fixed_frame = buffer_manager.fix_page(page(50), true);
+	std::memset(fixed_frame.get_data(), 'x', PAGE_SIZE);
+	for (uint64_t i = 0; i < 20; i++) {
+		auto& frame = buffer_manager.fix_page(page(i), true);
+		std::memset(frame.get_data(), static_cast<int>('a' + i), PAGE_SIZE);
+		buffer_manager.unfix_page(frame, true);
+	}
+
+	buzzdb::BackgroundWriterOptions options;
+	options.interval = std::chrono::milliseconds(1);
+	options.max_dirty_age = std::chrono::milliseconds(0);
+	buffer_manager.start_background_writer(options);
+	for (int i = 0; i < 5000 &&
+			buffer_manager.get_background_writer_stats().written_pages < 20; i++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	buffer_manager.stop_background_writer();
+
+	auto stats = buffer_manager.get_background_writer_stats();
+	EXPECT_EQ(20u, stats.written_pages);
+	EXPECT_LT(stats.write_requests, stats.written_pages);
+	EXPECT_EQ(0u, stats.foreground_writes);
+
+	auto file_handle = File::open_file(
+			std::to_string(BUFFER_SEGMENT).c_str(), File::READ);
+	EXPECT_EQ(20 * PAGE_SIZE, file_handle->size());
+	auto block = file_handle->read_block(19 * PAGE_SIZE, PAGE_SIZE);
+	EXPECT_EQ('a' + 19, block[PAGE_SIZE - 1]);
+	buffer_manager.unfix_page(fixed_frame, true);
+}
+
+TEST_P(BufferManagerTest, Stats) {
+	BufferManager buffer_manager(PAGE_SIZE, 10, GetParam());
+	buffer_manager.set_fix_latency_period(1);
+	for (uint64_t i = 0; i < 12; i++) {
+		buffer_manager.unfix_page(buffer_manager.fix_page(page(i), true), true);
+	}
+	buffer_manager.unfix_page(buffer_manager.fix_page(page(11), false), false);
+
+	auto stats = buffer_manager.get_stats();
+	EXPECT_EQ(1u, stats.get(buzzdb::BufferCounter::HITS));
+	EXPECT_EQ(12u, stats.get(buzzdb::BufferCounter::MISSES));
+	EXPECT_EQ(2u, stats.get(buzzdb::BufferCounter::EVICTIONS));
+	EXPECT_EQ(2u, stats.get(buzzdb::BufferCounter::DIRTY_EVICTIONS));
+	EXPECT_EQ(2u, stats.get(buzzdb::BufferCounter::WRITTEN_PAGES));
+	EXPECT_EQ(2 * PAGE_SIZE, stats.get(buzzdb::BufferCounter::WRITTEN_BYTES));
+	EXPECT_DOUBLE_EQ(1.0 / 13, stats.get_hit_ratio());
+
+	// With a period of 1, every fix is in the latency histogram
+	uint64_t fixes = 0;
+	for (uint64_t count : stats.fix_latency) {
+		fixes += count;
+	}
+	EXPECT_EQ(13u, fixes);
+	EXPECT_GT(stats.get_fix_latency_percentile(99).count(), 0);
+
+	auto segment_stats = buffer_manager.get_segment_stats(BUFFER_SEGMENT);
+	EXPECT_EQ(12u, segment_stats.get(buzzdb::BufferCounter::MISSES));
+	EXPECT_EQ(2u, segment_stats.get(buzzdb::BufferCounter::WRITTEN_PAGES));
+	EXPECT_EQ(0u, buffer_manager.get_segment_stats(BUFFER_SEGMENT + 1)
+			.get(buzzdb::BufferCounter::MISSES));
+
+	buffer_manager.reset_stats();
+	EXPECT_EQ(0u, buffer_manager.get_stats().get(buzzdb::BufferCounter::MISSES));
+
+	// Longer periods time a sample of the fixes, a period of 0 none
+	auto timed_fixes = [&]() {
+		uint64_t timed = 0;
+		for (uint64_t count : buffer_manager.get_stats().fix_latency) {
+			timed += count;
+		}
+		return timed;
+	};
+	buffer_manager.set_fix_latency_period(4);
+	for (int i = 0; i < 8; i++) {
+		buffer_manager.unfix_page(buffer_manager.fix_page(page(11), false), false);
+	}
+	EXPECT_EQ(2u, timed_fixes());
+	buffer_manager.set_fix_latency_period(0);
+	buffer_manager.unfix_page(buffer_manager.fix_page(page(11), false), false);
+	EXPECT_EQ(2u, timed_fixes());
+}
+
+TEST_P(BufferManagerTest, Partitions) {
+	BufferManager buffer_manager(PAGE_SIZE, 20, GetParam(), 2);
+	ASSERT_EQ(2u, buffer_manager.get_partition_count());
+	EXPECT_LT(buffer_manager.get_local_partition(), 2u);
+
+	// Pages are only loaded into the frames of their partition
+	std::vector<size_t> pages_per_partition(2);
+	for (uint64_t i = 0; i < 16 * BufferManager::PARTITION_EXTENT_PAGES; i += 8) {
+		size_t partition = buffer_manager.get_partition_of_page(page(i));
+		EXPECT_EQ(partition, buffer_manager.get_partition_of_page(
+				page(i - i % BufferManager::PARTITION_EXTENT_PAGES)));
+		auto& frame = buffer_manager.fix_page(page(i), true);
+		EXPECT_EQ(partition, buffer_manager.get_frame_id_of_page(page(i)) / 10);
+		buffer_manager.unfix_page(frame, true);
+		pages_per_partition[partition]++;
+	}
+	EXPECT_GT(pages_per_partition[0], 0u);
+	EXPECT_GT(pages_per_partition[1], 0u);
+	EXPECT_EQ(20u, buffer_manager.get_fifo_list().size() +
+			buffer_manager.get_lru_list().size());
+}
+
+TEST_P(BufferManagerTest, BorrowRemoteFrames) {
+	BufferManager buffer_manager(PAGE_SIZE, 20, GetParam(), 2);
+	uint64_t local = 0;
+	while (buffer_manager.get_partition_of_page(page(local)) != 0) {
+		local += BufferManager::PARTITION_EXTENT_PAGES;
+	}
+	uint64_t remote = 0;
+	while (buffer_manager.get_partition_of_page(page(remote)) != 1) {
+		remote += BufferManager::PARTITION_EXTENT_PAGES;
+	}
+
+	// With all frames of its partition fixed, a page borrows another frame
+	std::vector<BufferFrame*> frames;
+	for (uint64_t i = 0; i < 11; i++) {
+		frames.push_back(&buffer_manager.fix_page(page(local + i), true));
+		memcpy(frames.back()->get_data(), &i, sizeof(uint64_t));
+	}
+	EXPECT_EQ(1u, buffer_manager.get_frame_id_of_page(page(local + 10)) / 10);
+	EXPECT_EQ(1u, buffer_manager.get_stats()
+			.get(buzzdb::BufferCounter::REMOTE_FRAMES));
+	for (auto* frame : frames) {
+		buffer_manager.unfix_page(*frame, true);
+	}
+
+	// The borrowed frame is written back when the other partition needs it
+	for (uint64_t i = 0; i < 20; i++) {
+		buffer_manager.unfix_page(
+				buffer_manager.fix_page(page(remote + i), true), true);
+	}
+	EXPECT_EQ(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(
+			page(local + 10)));
+	for (uint64_t i = 0; i < 11; i++) {
+		BufferFrame& frame = buffer_manager.fix_page(page(local + i), false);
+		uint64_t value;
+		memcpy(&value, frame.get_data(), sizeof(uint64_t));
+		EXPECT_EQ(i, value);
+		buffer_manager.unfix_page(frame, false);
+	}
+
+	// Only fails when all frames are fixed
+	frames.clear();
+	for (uint64_t i = 0; i < 20; i++) {
+		frames.push_back(&buffer_manager.fix_page(page(local + i), false));
+	}
+	EXPECT_THROW(buffer_manager.fix_page(page(remote), false),
+			buzzdb::buffer_full_error);
+	for (auto* frame : frames) {
+		buffer_manager.unfix_page(*frame, false);
+	}
+}
+
+TEST_P(BufferManagerTest, RingKeepsWorkingSet) {
+	{
+		BufferManager buffer_manager(PAGE_SIZE, 10, GetParam());
+		for (uint64_t i = 0; i < 200; i++) {
+			buffer_manager.unfix_page(buffer_manager.fix_page(page(i), true), true);
+		}
+	}
+
+	BufferManager buffer_manager(PAGE_SIZE, 50, GetParam());
+	for (int round = 0; round < 2; round++) {
+		for (uint64_t i = 0; i < 20; i++) {
+			buffer_manager.unfix_page(buffer_manager.fix_page(page(i), false), false);
+		}
+	}
+
+	// Scan the rest of the segment through a small ring
+	BufferRing ring(8);
+	for (uint64_t i = 20; i < 200; i++) {
+		if (i % 4 == 0) {
+			buffer_manager.prefetch_pages(BUFFER_SEGMENT, i, 4, &ring);
+		}
+		auto& frame = buffer_manager.fix_page(page(i), false, &ring);
+		EXPECT_EQ('\0', frame.get_data()[0]);
+		buffer_manager.unfix_page(frame, false);
+	}
+	for (uint64_t i = 0; i < 20; i++) {
+		EXPECT_NE(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(i)));
+	}
+	EXPECT_GT(buffer_manager.get_stats().get(buzzdb::BufferCounter::RING_REUSES), 100u);
+}
+
+TEST_P(BufferManagerTest, MappedSegment) {
+	BufferManager buffer_manager(PAGE_SIZE, 10, GetParam());
+	for (uint64_t i = 0; i < 4; i++) {
+		auto& frame = buffer_manager.fix_page(page(i), true);
+		std::memset(frame.get_data(), static_cast<int>('a' + i), PAGE_SIZE);
+		buffer_manager.unfix_page(frame, true);
+	}
+
+	// Dirty pages are written back before the segment is mapped
+	buffer_manager.map_segment(BUFFER_SEGMENT);
+	EXPECT_EQ(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(0)));
+	for (uint64_t i = 0; i < 4; i++) {
+		auto& frame = buffer_manager.fix_page(page(i), false);
+		EXPECT_EQ('a' + i, frame.get_data()[PAGE_SIZE - 1]);
+		buffer_manager.unfix_page(frame, false);
+	}
+	EXPECT_EQ(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(3)));
+
+	EXPECT_THROW(buffer_manager.fix_page(page(0), true),
+			buzzdb::read_only_segment_error);
+	EXPECT_THROW(buffer_manager.fix_page(page(4), false), std::out_of_range);
+	auto& frame = buffer_manager.fix_page(page(0), false);
+	EXPECT_THROW(buffer_manager.unfix_page(frame, true),
+			buzzdb::read_only_segment_error);
+}
+
+INSTANTIATE_TEST_SUITE_P(ReplacementPolicies, BufferManagerTest,
+		::testing::Values(ReplacementPolicy::TWO_Q, ReplacementPolicy::LRU_K,
+				ReplacementPolicy::CLOCK));
+
+TEST(BufferManagerListTest, TwoQLists) {
+	BufferManager buffer_manager(PAGE_SIZE, 3, ReplacementPolicy::TWO_Q);
+	for (uint64_t i : {1, 2, 3, 2}) {
+		buffer_manager.unfix_page(buffer_manager.fix_page(page(i), false), false);
+	}
+	EXPECT_EQ(std::vector<uint64_t>({page(1), page(3)}), buffer_manager.get_fifo_list());
+	EXPECT_EQ(std::vector<uint64_t>({page(2)}), buffer_manager.get_lru_list());
+
+	// Victims are taken from the FIFO list first
+	buffer_manager.unfix_page(buffer_manager.fix_page(page(4), false), false);
+	EXPECT_EQ(std::vector<uint64_t>({page(3), page(4)}), buffer_manager.get_fifo_list());
+	EXPECT_EQ(std::vector<uint64_t>({page(2)}), buffer_manager.get_lru_list());
+}
+
+TEST(BufferManagerListTest, LRUKPrefersColdPages) {
+	BufferManager buffer_manager(PAGE_SIZE, 3, ReplacementPolicy::LRU_K);
+	for (uint64_t i : {1, 1, 2, 2, 3}) {
+		buffer_manager.unfix_page(buffer_manager.fix_page(page(i), false), false);
+	}
+	// Page 3 has been accessed only once and goes first
+	buffer_manager.unfix_page(buffer_manager.fix_page(page(4), false), false);
+	EXPECT_EQ(buzzdb::INVALID_FRAME_ID, buffer_manager.get_frame_id_of_page(page(3)));
+	EXPECT_EQ(std::vector<uint64_t>({page(1), page(2)}), buffer_manager.get_lru_list());
+}
+
+}  // namespace
@@ -1,6 +1,7 @@
 
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <atomic>
 #include <random>
 #include <sstream>
 #include <string>
@@ -10,6 +11,7 @@
 
 #include "optimizer/table_stats.h"
 #include "optimizer/join_optimizer.h"
+#include "operators/parallel_seq_scan.h"
 #include "operators/seq_scan.h"
 #include "heap/heap_file.h"
 #include "log/log_manager.h"
@@ -319,6 +321,357 @@ using buzzdb::File;
 	}
 
 
+	TEST(TableStatsTest, SharedBufferPool) {
+		// A table that fits into the pool is read from disk at most once
+		uint16_t small_table_id = 210;
+		uint64_t small_pages = TestUtils().populate_table(small_table_id, 2000, 2, 32);
+		auto& context = buzzdb::StorageContext::get_default();
+		TableStats first(small_table_id, IO_COST, small_pages, 2);
+		auto misses = context.get_buffer_manager().get_stats().get(
+				buzzdb::BufferCounter::MISSES);
+		TableStats second(small_table_id, IO_COST, small_pages, 2);
+		EXPECT_EQ(misses, context.get_buffer_manager().get_stats().get(
+				buzzdb::BufferCounter::MISSES));
+		EXPECT_EQ(2000u, second.estimate_table_cardinality(1.0));
+
+		// Scans can also use a segment of their own pool
+		HeapSegment heap_segment(small_table_id, context.get_log_manager(),
+				context.get_buffer_manager());
+		TableStats third(heap_segment, IO_COST, small_pages, 2);
+		EXPECT_EQ(2000u, third.estimate_table_cardinality(1.0));
+	}
+
+
+	TEST(SeqScanTest, NextBatch) {
+		uint16_t batch_table_id = 211;
+		uint64_t batch_pages = TestUtils().populate_table(batch_table_id, 3000, 3, 100);
+
+		std::vector<std::vector<int>> tuples;
+		buzzdb::operators::SeqScan scan(batch_table_id, batch_pages, 3);
+		scan.open();
+		while (scan.has_next()) {
+			tuples.push_back(scan.get_tuple());
+		}
+		ASSERT_EQ(3000u, tuples.size());
+
+		// A capacity that does not divide the tuples per page resumes mid-page
+		buzzdb::operators::ColumnBatch batch(3, 100);
+		size_t row_count = 0;
+		scan.reset();
+		while (scan.next_batch(batch)) {
+			ASSERT_LE(batch.size(), batch.capacity());
+			for (size_t row = 0; row < batch.size(); row++) {
+				for (size_t field = 0; field < 3; field++) {
+					ASSERT_EQ(tuples[row_count][field], batch.column(field)[row]);
+				}
+				row_count++;
+			}
+		}
+		EXPECT_EQ(tuples.size(), row_count);
+		EXPECT_EQ(0u, batch.size());
+		scan.close();
+	}
+
+
+	TEST(SeqScanTest, OneFixPerPage) {
+		uint16_t fix_table_id = 212;
+		uint64_t fix_pages = TestUtils().populate_table(fix_table_id, 2000, 2, 100);
+		auto& buffer_manager = buzzdb::StorageContext::get_default().get_buffer_manager();
+		auto fixes = [&]() {
+			auto stats = buffer_manager.get_stats();
+			return stats.get(buzzdb::BufferCounter::HITS) +
+					stats.get(buzzdb::BufferCounter::MISSES);
+		};
+
+		auto fixes_before = fixes();
+		buzzdb::operators::SeqScan scan(fix_table_id, fix_pages, 2);
+		scan.open();
+		size_t tuple_count = 0;
+		while (scan.has_next()) {
+			tuple_count++;
+		}
+		scan.close();
+		EXPECT_EQ(2000u, tuple_count);
+		EXPECT_EQ(fix_pages, fixes() - fixes_before);
+	}
+
+
+	TEST(SeqScanTest, MorselStealing) {
+		// One worker takes the morsels of all others once its own run out
+		buzzdb::operators::MorselScheduler scheduler(1000, 64, 4);
+		std::vector<bool> scanned(1000, false);
+		buzzdb::operators::Morsel morsel;
+		while (scheduler.next(3, morsel)) {
+			ASSERT_LE(morsel.end_page, 1000u);
+			for (uint64_t page = morsel.first_page; page < morsel.end_page; page++) {
+				ASSERT_FALSE(scanned[page]);
+				scanned[page] = true;
+			}
+		}
+		EXPECT_EQ(1000, std::count(scanned.begin(), scanned.end(), true));
+		EXPECT_FALSE(scheduler.next(0, morsel));
+	}
+
+	TEST(SeqScanTest, MorselQueues) {
+		// Morsels of odd extents go to queue 1, which is drained before stealing
+		buzzdb::operators::MorselScheduler scheduler(1000, 64, 2,
+				[](const buzzdb::operators::Morsel& morsel) {
+					return (morsel.first_page / 64) % 2;
+				});
+		buzzdb::operators::Morsel morsel;
+		size_t taken = 0;
+		while (scheduler.next(1, morsel)) {
+			EXPECT_EQ(taken < 8 ? 1u : 0u, (morsel.first_page / 64) % 2);
+			taken++;
+		}
+		EXPECT_EQ(16u, taken);
+	}
+
+
+	TEST(SeqScanTest, ParallelScan) {
+		uint16_t parallel_table_id = 213;
+		uint64_t parallel_pages = TestUtils().populate_table(parallel_table_id, 100000, 2, 1000);
+		ASSERT_GT(parallel_pages, 2 * buzzdb::operators::ParallelSeqScan::MORSEL_PAGES);
+
+		uint64_t expected_count = 0, expected_sum = 0;
+		buzzdb::operators::SeqScan scan(parallel_table_id, parallel_pages, 2);
+		scan.open();
+		while (scan.has_next()) {
+			auto tuple = scan.get_tuple();
+			expected_count++;
+			expected_sum += tuple[0] + tuple[1];
+		}
+		scan.close();
+
+		buzzdb::operators::ParallelSeqScan parallel_scan(parallel_table_id,
+				parallel_pages, 2, 4);
+		EXPECT_LE(parallel_scan.get_thread_count(), 4u);
+		EXPECT_GT(parallel_scan.get_thread_count(), 1u);
+		std::atomic<uint64_t> count{0}, sum{0};
+		parallel_scan.run([&](size_t worker_id,
+				const buzzdb::operators::ColumnBatch& batch) {
+			ASSERT_LT(worker_id, parallel_scan.get_thread_count());
+			uint64_t batch_sum = 0;
+			for (size_t row = 0; row < batch.size(); row++) {
+				batch_sum += batch.column(0)[row] + batch.column(1)[row];
+			}
+			count += batch.size();
+			sum += batch_sum;
+		});
+		EXPECT_EQ(expected_count, count);
+		EXPECT_EQ(expected_sum, sum);
+
+		TableStats stats(parallel_table_id, IO_COST, parallel_pages, 2);
+		EXPECT_EQ(expected_count, stats.estimate_table_cardinality(1.0));
+	}
+
+
+	TEST(FilterTest, Kernels) {
+		using buzzdb::operators::FilterKernel;
+		std::mt19937 generator(7);
+		std::uniform_int_distribution<int> distribution(-20, 20);
+		// Lengths that are no multiple of the vector width leave a remainder
+		std::vector<int> values(1000 + 13);
+		for (auto& value : values) {
+			value = distribution(generator);
+		}
+		std::vector<uint32_t> selection(values.size());
+		for (auto kernel : {FilterKernel::SCALAR, FilterKernel::AVX2,
+				FilterKernel::AVX512}) {
+			if (!buzzdb::operators::is_supported(kernel)) {
+				continue;
+			}
+			for (auto op : {PredicateType::EQ, PredicateType::NE, PredicateType::LT,
+					PredicateType::LE, PredicateType::GT, PredicateType::GE}) {
+				size_t selected = buzzdb::operators::select(kernel, values.data(),
+						values.size(), op, 3, selection.data());
+				std::vector<uint32_t> expected;
+				for (uint32_t i = 0; i < values.size(); i++) {
+					if (buzzdb::operators::evaluate(op, values[i], 3)) {
+						expected.push_back(i);
+					}
+				}
+				ASSERT_EQ(expected.size(), selected);
+				EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+						selection.begin()));
+			}
+		}
+	}
+
+
+	TEST(SeqScanTest, Predicates) {
+		uint16_t filter_table_id = 214;
+		uint64_t filter_pages = TestUtils().populate_table(filter_table_id, 5000, 3, 100);
+		std::vector<buzzdb::operators::Predicate> predicates = {
+				{0, PredicateType::LT, 40}, {2, PredicateType::GE, 50}};
+
+		std::vector<std::vector<int>> expected;
+		buzzdb::operators::SeqScan scan(filter_table_id, filter_pages, 3);
+		scan.open();
+		while (scan.has_next()) {
+			auto tuple = scan.get_tuple();
+			if (tuple[0] < 40 && tuple[2] >= 50) {
+				expected.push_back(tuple);
+			}
+		}
+		ASSERT_FALSE(expected.empty());
+
+		scan.set_predicates(predicates);
+		std::vector<std::vector<int>> filtered;
+		while (scan.has_next()) {
+			filtered.push_back(scan.get_tuple());
+		}
+		EXPECT_EQ(expected, filtered);
+
+		filtered.clear();
+		scan.reset();
+		buzzdb::operators::ColumnBatch batch(3, 100);
+		while (scan.next_batch(batch)) {
+			EXPECT_GT(batch.size(), 0u);
+			for (size_t row = 0; row < batch.size(); row++) {
+				filtered.push_back({batch.column(0)[row], batch.column(1)[row],
+						batch.column(2)[row]});
+			}
+		}
+		EXPECT_EQ(expected, filtered);
+		scan.close();
+	}
+
+
+	TEST(SeqScanTest, PaxPages) {
+		uint16_t pax_table_id = 215;
+		uint64_t pax_pages = TestUtils().populate_pax_table(pax_table_id, 5000, 3, 100);
+		// The pages hold as many tuples as their minipages have room for
+		EXPECT_EQ((5000 + buzzdb::PaxPage::get_capacity(buzzdb::BUFFER_PAGE_SIZE, 3) - 1) /
+				buzzdb::PaxPage::get_capacity(buzzdb::BUFFER_PAGE_SIZE, 3), pax_pages);
+
+		std::vector<std::vector<int>> tuples;
+		buzzdb::operators::SeqScan scan(pax_table_id, pax_pages, 3);
+		scan.open();
+		while (scan.has_next()) {
+			tuples.push_back(scan.get_tuple());
+		}
+		ASSERT_EQ(5000u, tuples.size());
+
+		auto& context = buzzdb::StorageContext::get_default();
+		buzzdb::PaxSegment pax_segment(pax_table_id, 3, context.get_buffer_manager());
+		std::vector<int> fields(3);
+		pax_segment.read(TID(0, 7), fields.data());
+		EXPECT_EQ(tuples[7], fields);
+
+		buzzdb::operators::ColumnBatch batch(3, 300);
+		std::vector<std::vector<int>> batch_tuples;
+		scan.reset();
+		while (scan.next_batch(batch)) {
+			for (size_t row = 0; row < batch.size(); row++) {
+				batch_tuples.push_back({batch.column(0)[row], batch.column(1)[row],
+						batch.column(2)[row]});
+			}
+		}
+		EXPECT_EQ(tuples, batch_tuples);
+
+		std::vector<std::vector<int>> expected;
+		for (auto& tuple : tuples) {
+			if (tuple[1] > 30 && tuple[2] != 5) {
+				expected.push_back(tuple);
+			}
+		}
+		scan.set_predicates({{1, PredicateType::GT, 30}, {2, PredicateType::NE, 5}});
+		batch_tuples.clear();
+		while (scan.next_batch(batch)) {
+			for (size_t row = 0; row < batch.size(); row++) {
+				batch_tuples.push_back({batch.column(0)[row], batch.column(1)[row],
+						batch.column(2)[row]});
+			}
+		}
+		EXPECT_EQ(expected, batch_tuples);
+		scan.close();
+
+		TableStats stats(pax_table_id, IO_COST, pax_pages, 3);
+		EXPECT_EQ(5000u, stats.estimate_table_cardinality(1.0));
+	}
+
+
+	TEST(SeqScanTest, ZoneMapSkipsPages) {
+		uint16_t zone_table_id = 216;
+		auto& context = buzzdb::StorageContext::get_default();
+		auto& buffer_manager = context.get_buffer_manager();
+		HeapSegment heap_segment(zone_table_id, context.get_log_manager(),
+				buffer_manager);
+		heap_segment.enable_zone_map(2);
+		// The first field ascends, so that every page covers a narrow range
+		int tuple_count = 10000;
+		for (int i = 0; i < tuple_count; i++) {
+			int fields[2] = {i, i % 10};
+			TID tid = heap_segment.allocate(sizeof(fields));
+			heap_segment.write(tid, reinterpret_cast<std::byte*>(fields),
+					sizeof(fields));
+		}
+		uint64_t zone_pages = heap_segment.page_count_;
+		ASSERT_GT(zone_pages, 10u);
+
+		buzzdb::ZoneMap zone_map(zone_table_id, buffer_manager);
+		buzzdb::PageSummary summary;
+		ASSERT_TRUE(zone_map.get_table_summary(zone_pages, summary));
+		EXPECT_EQ(static_cast<uint64_t>(tuple_count), summary.tuple_count);
+		EXPECT_EQ(0, summary.min[0]);
+		EXPECT_EQ(tuple_count - 1, summary.max[0]);
+		EXPECT_EQ(9, summary.max[1]);
+
+		auto heap_misses = [&]() {
+			return buffer_manager.get_segment_stats(zone_table_id).get(
+					buzzdb::BufferCounter::MISSES);
+		};
+		buffer_manager.flush_all_pages();
+		buffer_manager.discard_all_pages();
+		auto misses_before = heap_misses();
+
+		buzzdb::operators::SeqScan scan(heap_segment, zone_pages, 2);
+		scan.open();
+		scan.set_predicates({{0, PredicateType::GE, tuple_count - 5},
+				{1, PredicateType::EQ, 7}});
+		std::vector<std::vector<int>> filtered;
+		while (scan.has_next()) {
+			filtered.push_back(scan.get_tuple());
+		}
+		scan.close();
+		EXPECT_EQ(std::vector<std::vector<int>>({{tuple_count - 3, 7}}), filtered);
+		// Only the last page is read
+		EXPECT_EQ(1u, heap_misses() - misses_before);
+
+		TableStats stats(heap_segment, IO_COST, zone_pages, 2);
+		EXPECT_EQ(static_cast<uint64_t>(tuple_count),
+				stats.estimate_table_cardinality(1.0));
+		EXPECT_NEAR(0.5, stats.estimate_selectivity(0, PredicateType::LT,
+				tuple_count / 2), 0.02);
+
+		// Recreating the segment without a zone map drops the old one, and
+		// scans of the segment do not consult it
+		HeapSegment recreated(zone_table_id, context.get_log_manager(),
+				buffer_manager);
+		int fields[2] = {-1, 7};
+		TID tid = recreated.allocate(sizeof(fields));
+		recreated.write(tid, reinterpret_cast<std::byte*>(fields), sizeof(fields));
+		EXPECT_FALSE(zone_map.get_summary(0, summary));
+		EXPECT_FALSE(zone_map.get_summary(zone_pages - 1, summary));
+		buzzdb::operators::SeqScan recreated_scan(recreated, 1, 2);
+		recreated_scan.open();
+		recreated_scan.set_predicates({{0, PredicateType::LT, 0}});
+		ASSERT_TRUE(recreated_scan.has_next());
+		EXPECT_EQ(std::vector<int>({-1, 7}), recreated_scan.get_tuple());
+		recreated_scan.close();
+
+		// So does recreating it as a PAX segment
+		HeapSegment zoned(zone_table_id, context.get_log_manager(), buffer_manager);
+		zoned.enable_zone_map(2);
+		zoned.allocate(sizeof(fields));
+		ASSERT_TRUE(zone_map.get_summary(0, summary));
+		buzzdb::PaxSegment pax_segment(zone_table_id, 2, buffer_manager);
+		pax_segment.append(fields);
+		EXPECT_FALSE(zone_map.get_summary(0, summary));
+	}
+
+
 	TEST(TableStatsTest, EstimateSelectivityTest) {
 		// tuples between 0 and 32
 		int max_val = 32;	
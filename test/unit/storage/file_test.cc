@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "storage/file.h"
+#include "storage/uring_file.h"
+
+using buzzdb::File;
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 4096;
+const char* ASYNC_FILE = "async_file_test";
+
+class AsyncFileTest : public ::testing::Test {
+	void SetUp() {
+		auto file_handle = File::open_file(ASYNC_FILE, File::WRITE);
+		file_handle->resize(0);
+	}
+};
+
+TEST_F(AsyncFileTest, SubmitAndComplete) {
+	auto file_handle = File::open_async_file(ASYNC_FILE, File::WRITE);
+
+	// Keep many writes in flight at once
+	constexpr size_t BLOCK_COUNT = 100;
+	std::vector<std::vector<char>> blocks(BLOCK_COUNT);
+	std::vector<File::IORequest> requests;
+	for (size_t i = 0; i < BLOCK_COUNT; i++) {
+		blocks[i].assign(BLOCK_SIZE, static_cast<char>(i));
+		requests.emplace_back(File::IORequest::WRITE, i * BLOCK_SIZE,
+				BLOCK_SIZE, blocks[i].data());
+	}
+	file_handle->submit(requests.data(), requests.size());
+	file_handle->complete(requests.data(), requests.size());
+	for (auto& request : requests) {
+		EXPECT_TRUE(request.done);
+		EXPECT_EQ(BLOCK_SIZE, request.transferred);
+	}
+
+	// Read them back in reverse order
+	std::vector<std::vector<char>> read_blocks(BLOCK_COUNT,
+			std::vector<char>(BLOCK_SIZE));
+	requests.clear();
+	for (size_t i = BLOCK_COUNT; i > 0; i--) {
+		requests.emplace_back(File::IORequest::READ, (i - 1) * BLOCK_SIZE,
+				BLOCK_SIZE, read_blocks[i - 1].data());
+	}
+	file_handle->submit(requests.data(), requests.size());
+	file_handle->complete(requests.data(), requests.size());
+	for (size_t i = 0; i < BLOCK_COUNT; i++) {
+		EXPECT_EQ(blocks[i], read_blocks[i]);
+	}
+}
+
+TEST_F(AsyncFileTest, ReadPastEnd) {
+	auto file_handle = File::open_async_file(ASYNC_FILE, File::WRITE);
+	std::vector<char> block(BLOCK_SIZE, 'x');
+	File::IORequest request(File::IORequest::READ, 0, BLOCK_SIZE, block.data());
+	file_handle->submit(&request, 1);
+	file_handle->complete(&request, 1);
+	EXPECT_TRUE(request.done);
+	EXPECT_EQ(0u, request.transferred);
+	EXPECT_EQ('x', block[0]);
+}
+
+TEST_F(AsyncFileTest, IOModes) {
+	// Direct I/O needs aligned memory
+	auto block = std::unique_ptr<char, decltype(&std::free)>(
+			static_cast<char*>(std::aligned_alloc(
+					File::DIRECT_IO_ALIGNMENT, BLOCK_SIZE)),
+			&std::free);
+	for (auto io_mode : {File::IOMode::SYNC, File::IOMode::DSYNC,
+			File::IOMode::BUFFERED, File::IOMode::DIRECT}) {
+		auto file_handle = File::open_file(ASYNC_FILE, File::WRITE, io_mode);
+		if (io_mode == File::IOMode::DIRECT) {
+			EXPECT_NE(File::IOMode::SYNC, file_handle->get_io_mode());
+		} else {
+			EXPECT_EQ(io_mode, file_handle->get_io_mode());
+		}
+
+		char value = static_cast<char>(io_mode);
+		std::memset(block.get(), value, BLOCK_SIZE);
+		file_handle->write_block(block.get(), BLOCK_SIZE, BLOCK_SIZE);
+		file_handle->sync();
+		EXPECT_EQ(2 * BLOCK_SIZE, file_handle->size());
+
+		std::memset(block.get(), 0, BLOCK_SIZE);
+		file_handle->read_block(BLOCK_SIZE, BLOCK_SIZE, block.get());
+		EXPECT_EQ(value, block.get()[BLOCK_SIZE - 1]);
+	}
+}
+
+}  // namespace
@@ -0,0 +1,439 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "buffer/buffer_manager.h"
+#include "common/macros.h"
+#include "heap/free_space_inventory.h"
+#include "heap/heap_file.h"
+#include "heap/zone_map.h"
+#include "log/log_manager.h"
+#include "storage/file.h"
+#include "storage/schema.h"
+#include "storage/slotted_page.h"
+#include "storage/tuple.h"
+
+using buzzdb::BufferManager;
+using buzzdb::File;
+using buzzdb::HeapSegment;
+using buzzdb::LogManager;
+using buzzdb::TID;
+
+constexpr uint16_t HEAP_SEGMENT = 230;
+/// A second segment, for tests that compare two of them
+constexpr uint16_t OTHER_SEGMENT = 231;
+const char* HEAP_LOG_FILE = "heap_test.log";
+
+namespace {
+
+/// Every test gets empty segments, and a buffer pool and a log of its own.
+class HeapSegmentTest : public ::testing::Test {
+protected:
+	void SetUp() {
+		for (uint16_t segment_id : {HEAP_SEGMENT, OTHER_SEGMENT}) {
+			for (uint16_t file_id : {segment_id,
+					buzzdb::FreeSpaceInventory::get_segment_id(segment_id),
+					buzzdb::ZoneMap::get_segment_id(segment_id)}) {
+				File::open_file(std::to_string(file_id).c_str(), File::WRITE)
+						->resize(0);
+			}
+		}
+		log_file = File::open_file(HEAP_LOG_FILE, File::WRITE);
+		log_file->resize(0);
+		log_manager.reset(new LogManager(log_file.get()));
+		buffer_manager.reset(new BufferManager(buzzdb::BUFFER_PAGE_SIZE, 100));
+	}
+
+	void TearDown() {
+		// Writes back the pages before the log is closed
+		buffer_manager.reset();
+		log_manager.reset();
+	}
+
+	std::unique_ptr<File> log_file;
+	std::unique_ptr<LogManager> log_manager;
+	std::unique_ptr<BufferManager> buffer_manager;
+};
+
+/// Stores tuples of a schema in a heap segment.
+class TupleTest : public HeapSegmentTest {};
+
+TEST_F(HeapSegmentTest, FreeSpaceInventory) {
+	HeapSegment heap_segment(HEAP_SEGMENT, *log_manager, *buffer_manager);
+	auto& fsi = heap_segment.fsi_;
+	// A page of the lowest class that suffices surely has room
+	for (uint32_t size : {1u, 100u, 546u, 547u, 4000u, 8000u}) {
+		uint32_t min_class = fsi.get_min_class(size);
+		for (uint32_t free_space = size; free_space < size + 600; free_space++) {
+			if (fsi.get_class(free_space) >= min_class) {
+				EXPECT_GE(free_space, size);
+			}
+		}
+	}
+
+	auto fixes = [&]() {
+		auto stats = buffer_manager->get_stats();
+		return stats.get(buzzdb::BufferCounter::HITS) +
+				stats.get(buzzdb::BufferCounter::MISSES);
+	};
+	std::vector<char> record(1000, 'a');
+	for (int i = 0; i < 200; i++) {
+		heap_segment.allocate(record.size());
+	}
+	ASSERT_GT(heap_segment.page_count_, 20u);
+	// Allocating fixes the FSI page, the last page and maybe a new page,
+	// but none of the full pages
+	for (int i = 0; i < 10; i++) {
+		auto fixes_before = fixes();
+		heap_segment.allocate(record.size());
+		EXPECT_LE(fixes() - fixes_before, 5u);
+	}
+
+	// Small records still fill the rest of the pages
+	uint64_t page_count = heap_segment.page_count_;
+	TID tid = heap_segment.allocate(100);
+	EXPECT_LT(tid.value >> 16, page_count);
+	EXPECT_EQ(page_count, heap_segment.page_count_);
+
+	// Searches skip groups of pages without room, without reading their
+	// entries, also on a later FSI page
+	uint32_t max_free_space = 8000;
+	buzzdb::FreeSpaceInventory other_fsi(OTHER_SEGMENT, max_free_space,
+			*buffer_manager);
+	uint64_t other_page_count = 3 * buzzdb::BUFFER_PAGE_SIZE;
+	for (uint64_t page = 0; page < other_page_count; page++) {
+		other_fsi.add_page(page, 1000);
+	}
+	uint64_t free_page = other_page_count - 100;
+	other_fsi.update(free_page, max_free_space);
+	auto fixes_before = fixes();
+	uint64_t found;
+	ASSERT_TRUE(other_fsi.find(5000, other_page_count, found));
+	EXPECT_EQ(free_page, found);
+	EXPECT_EQ(1u, fixes() - fixes_before);
+	// Filling the page lowers the class of its group again
+	other_fsi.update(free_page, 1000);
+	EXPECT_FALSE(other_fsi.find(5000, other_page_count, found));
+	ASSERT_TRUE(other_fsi.find(500, other_page_count, found));
+	EXPECT_EQ(0u, found);
+}
+
+TEST(SlottedPageTest, FreeSlots) {
+	std::vector<char> buffer(buzzdb::BUFFER_PAGE_SIZE);
+	auto* page = new (buffer.data()) buzzdb::SlottedPage(buffer.data(),
+			buzzdb::BUFFER_PAGE_SIZE);
+	for (uint16_t i = 0; i < 10; i++) {
+		EXPECT_EQ(i, page->addSlot(8).value & 0xffff);
+	}
+	// Freed slots are reused last in, first out
+	page->freeSlot(2);
+	page->freeSlot(7);
+	page->freeSlot(4);
+	std::vector<uint16_t> visited;
+	for (auto it = page->begin(); it != page->end(); ++it) {
+		visited.push_back(it.get_slot_id());
+	}
+	EXPECT_EQ((std::vector<uint16_t>{0, 1, 3, 5, 6, 8, 9}), visited);
+	for (uint16_t expected : {4, 7, 2, 10, 11}) {
+		EXPECT_EQ(expected, page->addSlot(8).value & 0xffff);
+	}
+	EXPECT_EQ(12, page->header.slot_count);
+	EXPECT_EQ(12, page->header.first_free_slot);
+}
+
+TEST(SlottedPageTest, Compactify) {
+	std::vector<char> buffer(buzzdb::BUFFER_PAGE_SIZE);
+	auto* page = new (buffer.data()) buzzdb::SlottedPage(buffer.data(),
+			buzzdb::BUFFER_PAGE_SIZE);
+	page->header.overall_page_id = 0;
+	std::vector<uint16_t> slots;
+	while (page->get_required_space(1000) <= page->header.free_space) {
+		uint16_t slot_id = page->addSlot(1000).value & 0xffff;
+		auto slot = page->getSlot(slot_id);
+		memset(buffer.data() + slot.get_offset(), 'a' + slot_id, 1000);
+		slots.push_back(slot_id);
+	}
+	ASSERT_EQ(8u, slots.size());
+	uint32_t full_space = page->header.free_space;
+
+	// Erasing and shrinking fragments the page
+	page->erase(1);
+	page->erase(7);
+	ASSERT_TRUE(page->resize(4, 10, buzzdb::BUFFER_PAGE_SIZE));
+	EXPECT_EQ(full_space + 2990, page->header.free_space);
+	EXPECT_LT(page->get_contiguous_space(), 2000u);
+
+	// Growing a record beyond the contiguous space compactifies the page
+	ASSERT_TRUE(page->resize(3, 2500, buzzdb::BUFFER_PAGE_SIZE));
+	EXPECT_FALSE(page->resize(3, 2500 + page->header.free_space + 1,
+			buzzdb::BUFFER_PAGE_SIZE));
+	for (uint16_t slot_id : {0, 2, 3, 4, 5, 6}) {
+		auto tuple = page->get_tuple(slot_id);
+		EXPECT_EQ(static_cast<char>('a' + slot_id),
+				static_cast<char>(tuple.data[0]));
+		EXPECT_EQ(static_cast<char>('a' + slot_id),
+				static_cast<char>(tuple.data[slot_id == 4 ? 9 : 999]));
+	}
+
+	// The free slot at the end is dropped, the other one is reused
+	page->compactify(buzzdb::BUFFER_PAGE_SIZE);
+	EXPECT_EQ(7, page->header.slot_count);
+	EXPECT_EQ(page->get_contiguous_space(), page->header.free_space);
+	EXPECT_EQ(1, page->addSlot(8).value & 0xffff);
+}
+
+TEST_F(HeapSegmentTest, EraseAndResize) {
+	HeapSegment heap_segment(HEAP_SEGMENT, *log_manager, *buffer_manager);
+	auto write_record = [&](TID tid, size_t size, char c) {
+		std::vector<char> record(size, c);
+		heap_segment.write(tid, reinterpret_cast<std::byte*>(record.data()),
+				record.size());
+	};
+	auto read_record = [&](TID tid, size_t size) {
+		std::vector<char> record(size);
+		heap_segment.read(tid, reinterpret_cast<std::byte*>(record.data()),
+				record.size());
+		return record;
+	};
+
+	std::vector<TID> tids;
+	for (int i = 0; i < 400; i++) {
+		tids.push_back(heap_segment.allocate(100));
+		write_record(tids.back(), 100, 'a' + i % 26);
+	}
+	uint64_t page_count = heap_segment.page_count_;
+
+	// Erased records make room for new ones
+	for (int i = 0; i < 400; i += 2) {
+		heap_segment.erase(tids[i]);
+	}
+	for (int i = 0; i < 400; i += 2) {
+		tids[i] = heap_segment.allocate(100);
+		write_record(tids[i], 100, 'a' + i % 26);
+	}
+	EXPECT_EQ(page_count, heap_segment.page_count_);
+
+	// Records that outgrow their page move, but keep their TID
+	heap_segment.resize(tids[1], 4000);
+	EXPECT_EQ(std::vector<char>(100, 'b'), read_record(tids[1], 100));
+	write_record(tids[1], 4000, 'x');
+	heap_segment.resize(tids[1], 6000);
+	EXPECT_EQ(std::vector<char>(4000, 'x'), read_record(tids[1], 4000));
+	heap_segment.resize(tids[1], 100);
+	EXPECT_EQ(std::vector<char>(100, 'x'), read_record(tids[1], 100));
+
+	// Scans visit every record once, under its TID
+	std::vector<uint64_t> visited;
+	for (uint64_t page_id = 0; page_id < heap_segment.page_count_; page_id++) {
+		auto& frame = buffer_manager->fix_page(
+				BufferManager::get_overall_page_id(HEAP_SEGMENT, page_id), false);
+		auto* page = reinterpret_cast<buzzdb::SlottedPage*>(frame.get_data());
+		for (auto tuple : *page) {
+			visited.push_back(tuple.tid.value);
+		}
+		buffer_manager->unfix_page(frame, false);
+	}
+	std::vector<uint64_t> expected;
+	for (auto& tid : tids) {
+		expected.push_back(tid.value);
+	}
+	std::sort(visited.begin(), visited.end());
+	std::sort(expected.begin(), expected.end());
+	EXPECT_EQ(expected, visited);
+
+	// Updates that grow and shrink the records keep the footprint stable
+	page_count = heap_segment.page_count_;
+	for (int round = 0; round < 10; round++) {
+		for (size_t i = 0; i < tids.size(); i++) {
+			size_t size = (round + i) % 2 == 0 ? 40 : 160;
+			heap_segment.resize(tids[i], size);
+			write_record(tids[i], size, 'a' + i % 26);
+		}
+	}
+	EXPECT_LE(heap_segment.page_count_, page_count + 2);
+	for (size_t i = 0; i < tids.size(); i++) {
+		EXPECT_EQ(std::vector<char>(40, 'a' + i % 26), read_record(tids[i], 40));
+	}
+	heap_segment.erase(tids[1]);
+}
+
+TEST_F(HeapSegmentTest, BulkAppend) {
+	std::vector<int> fields;
+	for (int i = 0; i < 30000; i++) {
+		fields.push_back(i);
+		fields.push_back(-i);
+	}
+	uint32_t record_size = 2 * sizeof(int);
+
+	// Pages are packed like allocate packs them
+	HeapSegment allocated(OTHER_SEGMENT, *log_manager, *buffer_manager);
+	for (int i = 0; i < 30000; i++) {
+		allocated.allocate(record_size);
+	}
+
+	HeapSegment heap_segment(HEAP_SEGMENT, *log_manager, *buffer_manager);
+	heap_segment.enable_zone_map(2);
+	auto log_records = log_manager->get_total_log_records();
+	buffer_manager->reset_stats();
+	heap_segment.bulk_append(reinterpret_cast<std::byte*>(fields.data()),
+			record_size, 30000);
+	EXPECT_EQ(allocated.page_count_, heap_segment.page_count_);
+	EXPECT_EQ(log_records, log_manager->get_total_log_records());
+	// The heap pages are written, not fixed
+	auto stats = buffer_manager->get_segment_stats(HEAP_SEGMENT);
+	EXPECT_EQ(heap_segment.page_count_,
+			stats.get(buzzdb::BufferCounter::WRITTEN_PAGES));
+	EXPECT_EQ(0u, stats.get(buzzdb::BufferCounter::MISSES));
+
+	// The records are in consecutive slots of consecutive pages
+	auto& frame = buffer_manager->fix_page(
+			BufferManager::get_overall_page_id(HEAP_SEGMENT, 0), false);
+	uint16_t per_page =
+			reinterpret_cast<buzzdb::SlottedPage*>(frame.get_data())->header.slot_count;
+	buffer_manager->unfix_page(frame, false);
+	for (int i : {0, 1, 4000, 29999}) {
+		int record[2];
+		heap_segment.read(TID(i / per_page, i % per_page),
+				reinterpret_cast<std::byte*>(record), sizeof(record));
+		EXPECT_EQ(i, record[0]);
+		EXPECT_EQ(-i, record[1]);
+	}
+
+	buzzdb::ZoneMap zone_map(HEAP_SEGMENT, *buffer_manager);
+	buzzdb::PageSummary summary;
+	ASSERT_TRUE(zone_map.get_table_summary(heap_segment.page_count_, summary));
+	EXPECT_EQ(30000u, summary.tuple_count);
+	EXPECT_EQ(0, summary.min[0]);
+	EXPECT_EQ(29999, summary.max[0]);
+	EXPECT_EQ(-29999, summary.min[1]);
+
+	// Allocations continue after the appended pages
+	TID tid = heap_segment.allocate(record_size);
+	EXPECT_GE(tid.value >> 16, heap_segment.page_count_ - 1);
+
+	// Records that do not fit into a page are rejected
+	auto page_count = heap_segment.page_count_;
+	std::vector<std::byte> huge(buzzdb::BUFFER_PAGE_SIZE);
+	EXPECT_THROW(heap_segment.bulk_append(huge.data(), huge.size(), 1),
+			std::length_error);
+	EXPECT_EQ(page_count, heap_segment.page_count_);
+}
+
+TEST_F(HeapSegmentTest, BulkAppendOddPageSize) {
+	// Packed pages of this size do not start at multiples of 8
+	BufferManager odd_buffer_manager(4099, 100);
+	std::vector<int> fields;
+	for (int i = 0; i < 5000; i++) {
+		fields.push_back(i);
+		fields.push_back(-i);
+	}
+	uint32_t record_size = 2 * sizeof(int);
+
+	HeapSegment heap_segment(HEAP_SEGMENT, *log_manager, odd_buffer_manager);
+	heap_segment.bulk_append(reinterpret_cast<std::byte*>(fields.data()),
+			record_size, 5000);
+	ASSERT_GT(heap_segment.page_count_, 2u);
+
+	for (uint64_t page = 0; page < heap_segment.page_count_; page++) {
+		uint64_t page_id = BufferManager::get_overall_page_id(HEAP_SEGMENT, page);
+		auto& frame = odd_buffer_manager.fix_page(page_id, false);
+		EXPECT_EQ(page_id, reinterpret_cast<buzzdb::SlottedPage*>(frame.get_data())
+				->header.overall_page_id);
+		odd_buffer_manager.unfix_page(frame, false);
+	}
+	auto& frame = odd_buffer_manager.fix_page(
+			BufferManager::get_overall_page_id(HEAP_SEGMENT, 0), false);
+	uint16_t per_page =
+			reinterpret_cast<buzzdb::SlottedPage*>(frame.get_data())->header.slot_count;
+	odd_buffer_manager.unfix_page(frame, false);
+	for (int i = 0; i < 5000; i++) {
+		int record[2];
+		heap_segment.read(TID(i / per_page, i % per_page),
+				reinterpret_cast<std::byte*>(record), sizeof(record));
+		ASSERT_EQ(i, record[0]);
+		ASSERT_EQ(-i, record[1]);
+	}
+}
+
+TEST_F(TupleTest, TypedFields) {
+	using buzzdb::ColumnType;
+	buzzdb::Schema schema({{"id", ColumnType::INT64},
+			{"name", ColumnType::VARCHAR, true},
+			{"count", ColumnType::INT32, true},
+			{"key", ColumnType::INT64},
+			{"note", ColumnType::VARCHAR}});
+	// 64-bit fields first, no padding after the int, one bitmap byte and
+	// three offsets
+	EXPECT_EQ(0u, schema.get_offset(0));
+	EXPECT_EQ(8u, schema.get_offset(3));
+	EXPECT_EQ(16u, schema.get_offset(2));
+	EXPECT_EQ(20u, schema.get_null_bitmap_offset());
+	EXPECT_EQ(27u, schema.get_fixed_size());
+
+	HeapSegment heap_segment(HEAP_SEGMENT, *log_manager, *buffer_manager);
+	buzzdb::TupleBuilder builder(schema);
+	std::vector<TID> tids;
+	for (int i = 0; i < 1000; i++) {
+		builder.clear();
+		builder.set<ColumnType::INT64>(0, (int64_t{1} << 40) + i);
+		if (i % 3 == 0) {
+			builder.set_null(1);
+			builder.set_null(2);
+		} else {
+			builder.set<ColumnType::VARCHAR>(1, std::string(i % 17, 'n'));
+			builder.set<ColumnType::INT32>(2, -i);
+		}
+		builder.set<ColumnType::INT64>(3, -i);
+		builder.set<ColumnType::VARCHAR>(4, "note " + std::to_string(i));
+		EXPECT_EQ(schema.get_fixed_size() + (i % 3 == 0 ? 0 : i % 17) + 5 +
+				std::to_string(i).size(), builder.get_size());
+		auto tuple = builder.build();
+		tids.push_back(heap_segment.allocate(tuple.size()));
+		heap_segment.write(tids.back(), tuple.data(), tuple.size());
+	}
+
+	// Read the tuples in place, and the keys of a page column-wise
+	int i = 0;
+	for (uint64_t page_id = 0; page_id < heap_segment.page_count_; page_id++) {
+		auto& frame = buffer_manager->fix_page(
+				BufferManager::get_overall_page_id(HEAP_SEGMENT, page_id), false);
+		auto* page = reinterpret_cast<buzzdb::SlottedPage*>(frame.get_data());
+		std::vector<const std::byte*> records;
+		int first = i;
+		for (auto tuple : *page) {
+			buzzdb::TupleReader reader(schema, tuple.data);
+			EXPECT_EQ((int64_t{1} << 40) + i, reader.get<ColumnType::INT64>(0));
+			EXPECT_EQ(i % 3 == 0, reader.is_null(1));
+			EXPECT_EQ(i % 3 == 0, reader.is_null(2));
+			EXPECT_FALSE(reader.is_null(4));
+			EXPECT_EQ(i % 3 == 0 ? "" : std::string(i % 17, 'n'),
+					reader.get<ColumnType::VARCHAR>(1));
+			EXPECT_EQ(i % 3 == 0 ? 0 : -i, reader.get<ColumnType::INT32>(2));
+			EXPECT_EQ("note " + std::to_string(i),
+					reader.get<ColumnType::VARCHAR>(4));
+			records.push_back(tuple.data);
+			i++;
+		}
+		buffer_manager->unfix_page(frame, false);
+		std::vector<int64_t> keys;
+		heap_segment.read_column<ColumnType::INT64>(page_id, schema, 3, keys);
+		ASSERT_EQ(records.size(), keys.size());
+		for (size_t j = 0; j < keys.size(); j++) {
+			EXPECT_EQ(-(first + static_cast<int64_t>(j)), keys[j]);
+		}
+	}
+	EXPECT_EQ(1000, i);
+
+	// The offsets of the variable-length fields are 16 bits wide
+	builder.set<ColumnType::VARCHAR>(4, std::string(UINT16_MAX, 'x'));
+	EXPECT_THROW(builder.build(), std::length_error);
+}
+
+}  // namespace
@@ -11,41 +11,54 @@ using buzzdb::File;
 	auto catalog_file = buzzdb::File::open_file(buzzdb::CATALOG.c_str(), buzzdb::File::WRITE);
 
     uint64_t TestUtils::populate_table(uint64_t table_id, uint32_t num_tuples, uint32_t num_cols, uint32_t max_rand){
-		BufferManager buffer_manager(buzzdb::BUFFER_PAGE_SIZE, buzzdb::BUFFER_PAGE_COUNT);
-		const char* LOG_FILE = buzzdb::LOG_FILE_PATH.c_str();
-		auto logfile = buzzdb::File::open_file(LOG_FILE, buzzdb::File::WRITE);
-		LogManager log_manager(logfile.get());
-		HeapSegment heap_segment(table_id, log_manager, buffer_manager);
+		// Load through the pool that the scans use, so they see the new pages
+		auto& context = buzzdb::StorageContext::get_default();
+		BufferManager& buffer_manager = context.get_buffer_manager();
+		HeapSegment heap_segment(table_id, context.get_log_manager(), buffer_manager);
+		heap_segment.enable_zone_map(num_cols);
 
 		/* initialize random seed: */
 		// srand(100);
 		std::random_device device;
 		std::mt19937 generator(device());
 		std::vector<uint32_t> tuples = generate_random(max_rand, num_tuples*num_cols, generator);
-		auto tuple_size = sizeof(uint32_t)*num_cols; // field1 | field2 | 
+		// The tuples are laid out one after the other: field1 | field2 | ...
+		auto tuple_size = sizeof(uint32_t)*num_cols;
+		heap_segment.bulk_append(reinterpret_cast<const std::byte *>(tuples.data()),
+				tuple_size, num_tuples);
+		buffer_manager.flush_all_pages();
+		char data[2*sizeof(uint64_t)]; 
+		memcpy(&data, &table_id, sizeof(uint64_t));
+		memcpy(&data[sizeof(uint64_t)], &heap_segment.page_count_, sizeof(uint64_t));
+		catalog_file->write_block(data, 0, 2*sizeof(uint64_t));
+		
+		return heap_segment.page_count_;
+	}
+	
+    uint64_t TestUtils::populate_pax_table(uint64_t table_id, uint32_t num_tuples, uint32_t num_cols, uint32_t max_rand){
+		auto& context = buzzdb::StorageContext::get_default();
+		BufferManager& buffer_manager = context.get_buffer_manager();
+		buzzdb::PaxSegment pax_segment(table_id, num_cols, buffer_manager);
+		pax_segment.enable_zone_map();
+
+		std::random_device device;
+		std::mt19937 generator(device());
+		std::vector<uint32_t> tuples = generate_random(max_rand, num_tuples*num_cols, generator);
+		std::vector<int> fields(num_cols);
 		std::size_t i = 0;
 		while(i < tuples.size()){
-			// Allocate slot
-			auto tid = heap_segment.allocate(tuple_size);
-			// Write buffer
-			std::vector<char> buf;
-			buf.resize(tuple_size);
-
-			// Populate tuple
 			for(size_t j=0; j<num_cols;j++){
-				int field = tuples[i++];
-				memcpy(buf.data() + j*sizeof(uint32_t), &field, sizeof(uint32_t));
+				fields[j] = tuples[i++];
 			}
-			heap_segment.write(tid, reinterpret_cast<std::byte *>(buf.data()),
-					tuple_size);
+			pax_segment.append(fields.data());
 		}
 		buffer_manager.flush_all_pages();
 		char data[2*sizeof(uint64_t)]; 
 		memcpy(&data, &table_id, sizeof(uint64_t));
-		memcpy(&data[sizeof(uint64_t)], &heap_segment.page_count_, sizeof(uint64_t));
+		memcpy(&data[sizeof(uint64_t)], &pax_segment.page_count_, sizeof(uint64_t));
 		catalog_file->write_block(data, 0, 2*sizeof(uint64_t));
-		
-		return heap_segment.page_count_;
+
+		return pax_segment.page_count_;
 	}
 	
 	std::vector<uint32_t> TestUtils::generate_random(int N, int k, std::mt19937& gen)
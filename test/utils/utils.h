@@ -7,6 +7,8 @@
 
 #include "operators/seq_scan.h"
 #include "heap/heap_file.h"
+#include "heap/pax_segment.h"
+#include "heap/storage_context.h"
 #include "log/log_manager.h"
 #include "transaction/transaction_manager.h"
 #include "common/macros.h"
@@ -19,6 +21,8 @@ class TestUtils{
     public:
         	std::vector<uint32_t> generate_random(int N, int k, std::mt19937& gen);
             uint64_t populate_table(uint64_t table_id, uint32_t num_tuples, uint32_t num_cols, uint32_t max_rand);
+            /// Like populate_table, but stores the table in PAX pages.
+            uint64_t populate_pax_table(uint64_t table_id, uint32_t num_tuples, uint32_t num_cols, uint32_t max_rand);
             bool check_constant(std::vector<double> stats);
             bool check_linear(std::vector<double> stats);
             bool check_quadratic(std::vector<double> stats);